@@ -0,0 +1,388 @@
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <Atom.h>
+
+#include "Benchmark.h"
+
+/**
+ * concurrent_bench: measures the throughput and latency of Atom operations.
+ *
+ * Every run hammers a single atom from a number of threads. Each thread
+ * performs the read operation with the given probability and the write
+ * operation otherwise. The sweep covers every combination of lock policy,
+ * value size, thread count, read percentage, read operation, and write
+ * operation given on the command line; runs at 0% or 100% reads are only
+ * made once per write or read operation respectively.
+ *
+ * Results go to standard output as CSV (the default) or JSON, one row per
+ * run. Build in release mode for meaningful numbers.
+ */
+
+namespace
+{
+  /**
+   * A trivially copyable value of the given size.
+   */
+  template<size_t N>
+  struct Payload
+  {
+    std::array<unsigned char, N> bytes{};
+
+    bool operator == (const Payload& other) const
+    {
+      return bytes == other.bytes;
+    }
+
+    bool operator != (const Payload& other) const
+    {
+      return bytes != other.bytes;
+    }
+  };
+
+  enum class Op
+  {
+    None,
+    Value,
+    With,
+    Reset,
+    Swap,
+    Modify,
+    CompareAndSet
+  };
+
+  const char* nameOf(Op op)
+  {
+    switch (op)
+    {
+      case Op::Value: return "Value";
+      case Op::With: return "With";
+      case Op::Reset: return "Reset";
+      case Op::Swap: return "Swap";
+      case Op::Modify: return "Modify";
+      case Op::CompareAndSet: return "CompareAndSet";
+      default: return "-";
+    }
+  }
+
+  Op parseOp(const std::string& name)
+  {
+    for (Op op : { Op::Value, Op::With, Op::Reset, Op::Swap, Op::Modify, Op::CompareAndSet })
+    {
+      if (name == nameOf(op))
+      {
+        return op;
+      }
+    }
+
+    throw std::invalid_argument("unknown operation: " + name);
+  }
+
+  struct Options
+  {
+    std::vector<std::string> locks{ "default", "exclusive", "shared" };
+    std::vector<size_t> sizes{ 8, 64, 512 };
+    std::vector<int> threads{ 1, 2, 4, 8 };
+    std::vector<int> readPercents{ 0, 50, 90, 100 };
+    std::vector<Op> readOps{ Op::Value, Op::With };
+    std::vector<Op> writeOps{ Op::Reset, Op::Swap, Op::Modify, Op::CompareAndSet };
+    std::chrono::milliseconds duration{ 100 };
+    bool json{ false };
+  };
+
+  std::vector<std::string> split(const std::string& list)
+  {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+      if (!item.empty())
+      {
+        items.push_back(item);
+      }
+    }
+
+    return items;
+  }
+
+  template<typename N>
+  std::vector<N> splitNumbers(const std::string& list)
+  {
+    std::vector<N> numbers;
+
+    for (const std::string& item : split(list))
+    {
+      numbers.push_back(static_cast<N>(std::stoll(item)));
+    }
+
+    return numbers;
+  }
+
+  std::vector<Op> splitOps(const std::string& list)
+  {
+    std::vector<Op> ops;
+
+    for (const std::string& item : split(list))
+    {
+      ops.push_back(parseOp(item));
+    }
+
+    return ops;
+  }
+
+  void usage()
+  {
+    std::cerr
+      << "usage: concurrent_bench [options]\n"
+      << "  --format=csv|json           output format (csv)\n"
+      << "  --duration-ms=N             length of every run (100)\n"
+      << "  --threads=1,2,4,8           thread counts\n"
+      << "  --read-percent=0,50,90,100  share of read operations\n"
+      << "  --sizes=8,64,512            value sizes in bytes: 8, 64, 512, 4096\n"
+      << "  --locks=default,exclusive,shared\n"
+      << "                              default, exclusive, shared, spin,\n"
+      << "                              adaptive, seqlock, flat, leftright\n"
+      << "  --read-ops=Value,With\n"
+      << "  --write-ops=Reset,Swap,Modify,CompareAndSet\n";
+  }
+
+  Options parseOptions(int argc, char* argv[])
+  {
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+      std::string arg(argv[i]);
+      size_t equals = arg.find('=');
+      std::string name = arg.substr(0, equals);
+      std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+      if (name == "--help")
+      {
+        usage();
+        std::exit(EXIT_SUCCESS);
+      }
+      else if (name == "--format" && (value == "csv" || value == "json"))
+      {
+        options.json = value == "json";
+      }
+      else if (name == "--duration-ms")
+      {
+        options.duration = std::chrono::milliseconds(std::stoll(value));
+      }
+      else if (name == "--threads")
+      {
+        options.threads = splitNumbers<int>(value);
+      }
+      else if (name == "--read-percent")
+      {
+        options.readPercents = splitNumbers<int>(value);
+      }
+      else if (name == "--sizes")
+      {
+        options.sizes = splitNumbers<size_t>(value);
+      }
+      else if (name == "--locks")
+      {
+        options.locks = split(value);
+      }
+      else if (name == "--read-ops")
+      {
+        options.readOps = splitOps(value);
+      }
+      else if (name == "--write-ops")
+      {
+        options.writeOps = splitOps(value);
+      }
+      else
+      {
+        throw std::invalid_argument("unknown option: " + arg);
+      }
+    }
+
+    return options;
+  }
+
+  template<typename V, typename AtomType>
+  inline void apply(AtomType& atom, Op op)
+  {
+    switch (op)
+    {
+      case Op::Value:
+        DoNotOptimize(atom.Value());
+        break;
+
+      case Op::With:
+        atom.With([](const V& value){ DoNotOptimize(value.bytes[0]); });
+        break;
+
+      case Op::Reset:
+        DoNotOptimize(atom.Reset(V()));
+        break;
+
+      case Op::Swap:
+        DoNotOptimize(atom.Swap([](const V& value)
+        {
+          V newValue(value);
+          newValue.bytes[0]++;
+          return newValue;
+        }));
+        break;
+
+      case Op::Modify:
+        DoNotOptimize(atom.Modify([](V& value){ value.bytes[0]++; }));
+        break;
+
+      case Op::CompareAndSet:
+      {
+        V oldValue = atom.Value();
+        V newValue(oldValue);
+        newValue.bytes[0]++;
+        DoNotOptimize(atom.CompareAndSet(oldValue, newValue));
+        break;
+      }
+
+      default:
+        break;
+    }
+  }
+
+  /**
+   * Runs every combination of thread count, read percentage, and operation
+   * against one kind of atom.
+   */
+  template<typename V, typename AtomType>
+  void sweep(const std::string& lock, const Options& options, BenchmarkReporter& reporter)
+  {
+    for (int threads : options.threads)
+    {
+      for (int readPercent : options.readPercents)
+      {
+        std::vector<Op> readOps = readPercent > 0 ? options.readOps : std::vector<Op>{ Op::None };
+        std::vector<Op> writeOps = readPercent < 100 ? options.writeOps : std::vector<Op>{ Op::None };
+
+        for (Op readOp : readOps)
+        {
+          for (Op writeOp : writeOps)
+          {
+            AtomType atom{ V() };
+
+            BenchmarkResult result = RunBenchmark(threads, options.duration, [&](Random& random)
+            {
+              if (static_cast<int>(random.Next() % 100) < readPercent)
+              {
+                apply<V>(atom, readOp);
+              }
+              else
+              {
+                apply<V>(atom, writeOp);
+              }
+            });
+
+            reporter.Add(BenchmarkRow{ lock, nameOf(readOp), nameOf(writeOp),
+                                       readPercent, threads, sizeof(V), result });
+          }
+        }
+      }
+    }
+  }
+
+  template<typename V>
+  void sweepLock(const std::string& lock, const Options& options, BenchmarkReporter& reporter)
+  {
+    if (lock == "default")
+    {
+      sweep<V, Atom<V>>(lock, options, reporter);
+    }
+    else if (lock == "exclusive")
+    {
+      sweep<V, Atom<V, ExclusiveLock>>(lock, options, reporter);
+    }
+    else if (lock == "shared")
+    {
+      sweep<V, Atom<V, SharedLock>>(lock, options, reporter);
+    }
+    else if (lock == "spin")
+    {
+      sweep<V, Atom<V, SpinLock>>(lock, options, reporter);
+    }
+    else if (lock == "adaptive")
+    {
+      sweep<V, Atom<V, AdaptiveLock>>(lock, options, reporter);
+    }
+    else if (lock == "seqlock")
+    {
+      sweep<V, Atom<V, SeqLock>>(lock, options, reporter);
+    }
+    else if (lock == "flat")
+    {
+      sweep<V, Atom<V, FlatCombining>>(lock, options, reporter);
+    }
+    else if (lock == "leftright")
+    {
+      sweep<V, Atom<V, LeftRight>>(lock, options, reporter);
+    }
+    else
+    {
+      throw std::invalid_argument("unknown lock policy: " + lock);
+    }
+  }
+
+  void sweepSize(size_t size, const std::string& lock, const Options& options, BenchmarkReporter& reporter)
+  {
+    switch (size)
+    {
+      case 8: sweepLock<Payload<8>>(lock, options, reporter); break;
+      case 64: sweepLock<Payload<64>>(lock, options, reporter); break;
+      case 512: sweepLock<Payload<512>>(lock, options, reporter); break;
+      case 4096: sweepLock<Payload<4096>>(lock, options, reporter); break;
+      default: throw std::invalid_argument("unsupported value size: " + std::to_string(size));
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  Options options;
+
+  try
+  {
+    options = parseOptions(argc, argv);
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << "\n";
+    usage();
+    return EXIT_FAILURE;
+  }
+
+  try
+  {
+    BenchmarkReporter reporter(std::cout, options.json);
+
+    for (const std::string& lock : options.locks)
+    {
+      for (size_t size : options.sizes)
+      {
+        sweepSize(size, lock, options, reporter);
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
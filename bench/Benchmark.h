@@ -0,0 +1,280 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A minimal, dependency free harness for multi-threaded throughput and
+ * latency benchmarks.
+ *
+ * RunBenchmark() starts the requested number of threads, releases them at
+ * the same time, lets every thread call the operation in a tight loop for
+ * the given duration, and reports the total throughput together with
+ * latency percentiles. Every operation is counted towards the throughput but only
+ * every `SampleInterval`-th operation is timed, which keeps the clock reads
+ * from dominating very short operations.
+ */
+typedef std::chrono::steady_clock BenchmarkClock;
+
+/**
+ * Keeps the compiler from optimizing away a value which is otherwise
+ * unused.
+ */
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "g"(&value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+/**
+ * A xorshift generator, one per thread, for choosing between operations
+ * without touching shared state.
+ */
+class Random
+{
+public:
+
+  explicit Random(uint32_t seed)
+    : mSeed(seed | 1)
+    {
+    }
+
+  uint32_t Next()
+  {
+    mSeed ^= mSeed << 13;
+    mSeed ^= mSeed >> 17;
+    mSeed ^= mSeed << 5;
+    return mSeed;
+  }
+
+private:
+
+  uint32_t mSeed;
+};
+
+/**
+ * The outcome of one benchmark run. Latencies are in nanoseconds.
+ */
+struct BenchmarkResult
+{
+  uint64_t operations{ 0 };
+  double seconds{ 0 };
+  uint64_t p50{ 0 };
+  uint64_t p99{ 0 };
+  uint64_t p999{ 0 };
+
+  double OpsPerSecond() const
+  {
+    return seconds > 0 ? operations / seconds : 0;
+  }
+};
+
+/**
+ * Every how many operations one is timed.
+ */
+constexpr uint64_t SampleInterval = 8;
+
+/**
+ * Runs the benchmark.
+ *
+ * @param threadCount The number of threads calling the operation.
+ * @param duration How long to keep calling it.
+ * @param operation Called as `operation(random)` from every thread, where
+ *        `random` is the thread's own Random.
+ *
+ * @return The throughput and latency percentiles.
+ */
+template<typename Operation>
+BenchmarkResult RunBenchmark(int threadCount, std::chrono::milliseconds duration, Operation operation)
+{
+  std::atomic<int> ready{ 0 };
+  std::atomic<bool> start{ false };
+  std::atomic<bool> stop{ false };
+
+  std::vector<uint64_t> counts(threadCount, 0);
+  std::vector<std::vector<uint64_t>> samples(threadCount);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&, i]()
+    {
+      Random random(static_cast<uint32_t>(i + 1) * 2654435761u);
+      std::vector<uint64_t>& latencies = samples[i];
+      uint64_t count{ 0 };
+
+      latencies.reserve(1 << 16);
+      ready.fetch_add(1);
+
+      while (!start.load(std::memory_order_acquire))
+      {
+        std::this_thread::yield();
+      }
+
+      while (!stop.load(std::memory_order_relaxed))
+      {
+        if (count % SampleInterval == 0)
+        {
+          BenchmarkClock::time_point before = BenchmarkClock::now();
+          operation(random);
+          BenchmarkClock::time_point after = BenchmarkClock::now();
+
+          latencies.push_back(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+        }
+        else
+        {
+          operation(random);
+        }
+
+        count++;
+      }
+
+      counts[i] = count;
+    });
+  }
+
+  while (ready.load() < threadCount)
+  {
+    std::this_thread::yield();
+  }
+
+  BenchmarkClock::time_point begin = BenchmarkClock::now();
+  start.store(true, std::memory_order_release);
+
+  std::this_thread::sleep_for(duration);
+
+  stop.store(true, std::memory_order_relaxed);
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  BenchmarkResult result;
+  result.seconds = std::chrono::duration<double>(BenchmarkClock::now() - begin).count();
+
+  std::vector<uint64_t> latencies;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    result.operations += counts[i];
+    latencies.insert(latencies.end(), samples[i].begin(), samples[i].end());
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  auto percentile = [&latencies](double fraction) -> uint64_t
+  {
+    if (latencies.empty())
+    {
+      return 0;
+    }
+
+    return latencies[static_cast<size_t>(fraction * (latencies.size() - 1))];
+  };
+
+  result.p50 = percentile(0.5);
+  result.p99 = percentile(0.99);
+  result.p999 = percentile(0.999);
+
+  return result;
+}
+
+/**
+ * One row of the report: the parameters of a run and its result.
+ */
+struct BenchmarkRow
+{
+  std::string lock;
+  std::string readOp;
+  std::string writeOp;
+  int readPercent;
+  int threads;
+  size_t valueSize;
+  BenchmarkResult result;
+};
+
+/**
+ * Writes rows as CSV or as a JSON array, one row at a time so long sweeps
+ * show progress.
+ */
+class BenchmarkReporter
+{
+public:
+
+  BenchmarkReporter(std::ostream& out, bool json)
+    : mOut(out)
+    , mJson(json)
+    {
+      if (mJson)
+      {
+        mOut << "[";
+      }
+      else
+      {
+        mOut << "lock,read_op,write_op,read_percent,threads,value_size,"
+             << "ops_per_sec,p50_ns,p99_ns,p999_ns\n";
+      }
+    }
+
+  ~BenchmarkReporter()
+  {
+    if (mJson)
+    {
+      mOut << "\n]\n";
+    }
+  }
+
+  void Add(const BenchmarkRow& row)
+  {
+    if (mJson)
+    {
+      mOut << (mRows == 0 ? "\n" : ",\n")
+           << "  {\"lock\": \"" << row.lock << "\""
+           << ", \"read_op\": \"" << row.readOp << "\""
+           << ", \"write_op\": \"" << row.writeOp << "\""
+           << ", \"read_percent\": " << row.readPercent
+           << ", \"threads\": " << row.threads
+           << ", \"value_size\": " << row.valueSize
+           << ", \"ops_per_sec\": " << static_cast<uint64_t>(row.result.OpsPerSecond())
+           << ", \"p50_ns\": " << row.result.p50
+           << ", \"p99_ns\": " << row.result.p99
+           << ", \"p999_ns\": " << row.result.p999
+           << "}";
+    }
+    else
+    {
+      mOut << row.lock << ','
+           << row.readOp << ','
+           << row.writeOp << ','
+           << row.readPercent << ','
+           << row.threads << ','
+           << row.valueSize << ','
+           << static_cast<uint64_t>(row.result.OpsPerSecond()) << ','
+           << row.result.p50 << ','
+           << row.result.p99 << ','
+           << row.result.p999 << '\n';
+    }
+
+    mOut.flush();
+    mRows++;
+  }
+
+private:
+
+  std::ostream& mOut;
+  bool mJson;
+  size_t mRows{ 0 };
+};
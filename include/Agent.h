@@ -0,0 +1,312 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include <Atom.h>
+#include <Executor.h>
+#include <ThreadPoolExecutor.h>
+
+/**
+ * What an Agent does when an action throws or produces an invalid value.
+ */
+enum class AgentErrorMode
+{
+  /**
+   * Records the error and carries on with the next action.
+   */
+  Continue,
+
+  /**
+   * Records the error and stops running actions until Restart() is called.
+   * Actions sent in the meantime are queued.
+   */
+  Fail
+};
+
+/**
+ * Agents provide shared access to independent state which changes
+ * asynchronously.
+ *
+ * Where an Atom is changed synchronously by the calling thread, an Agent is
+ * changed by sending it actions. Send() queues the action and returns at
+ * once; the actions of one agent run one at a time, in the order they were
+ * sent, on an Executor. Each action is called with the current value and
+ * returns the new value, which is validated like the value of an Atom.
+ * Actions are never run concurrently, so unlike Atom::Swap() they are
+ * called exactly once and may have side effects.
+ *
+ * Value() reads the current value at any time. The value is kept in an
+ * Atom and the action runs without holding its lock, so readers only ever
+ * wait for the copy of a new value. Choose a LockPolicy such as LeftRight to
+ * make reads wait-free.
+ *
+ * @code
+ * Agent<std::vector<Event>> log{ std::vector<Event>() };
+ * log.Send([event](const std::vector<Event>& events)
+ * {
+ *   std::vector<Event> newEvents(events);
+ *   newEvents.push_back(event);
+ *   return newEvents;
+ * });
+ * @endcode
+ *
+ * @note The destructor waits for every queued action to finish.
+ *
+ * @tparam T The type of the value.
+ * @tparam LockPolicy How the value is protected. See LockPolicy.h.
+ * @tparam Validator The type of the validation function.
+ *
+ * @see http://clojure.org/agents Clojure Agents
+ * @see http://ruby-concurrency.github.io/concurrent-ruby/master/Concurrent/Agent.html
+ *      Concurrent Ruby Agent
+ */
+template<typename T,
+         typename LockPolicy = DefaultLockPolicy<T>,
+         typename Validator = std::function<bool(const T&)>>
+class Agent
+{
+public:
+
+  /**
+   * An action sent to the agent.
+   *
+   * @param currentValue The current value.
+   *
+   * @return The new value which will be validated and possibly saved.
+   */
+  typedef std::function<T(const T& currentValue)> ActionFunc;
+
+  /**
+   * Constructs a new Agent.
+   *
+   * @param initialValue The initial value.
+   * @param validator Function to be used when validating a new value.
+   * @param errorMode What to do when an action fails. See AgentErrorMode.
+   * @param executor Where the actions run.
+   */
+  explicit Agent(const T& initialValue,
+                 Validator validator = Validator(),
+                 AgentErrorMode errorMode = AgentErrorMode::Continue,
+                 Executor& executor = SharedExecutor())
+    : mState(initialValue)
+    , mValidator(validator)
+    , mErrorMode(errorMode)
+    , mExecutor(executor)
+    {
+    }
+
+  Agent(const Agent&) = delete;
+  Agent& operator = (const Agent&) = delete;
+
+  virtual ~Agent()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return !mRunning; });
+  }
+
+  /**
+   * Obtain a copy of the current value. Never waits for an action.
+   *
+   * @return The current value.
+   */
+  T Value()
+  {
+    return mState.Value();
+  }
+
+  /**
+   * Queues the action and returns immediately.
+   *
+   * @param func The action, called with the current value and returning
+   *        the new value.
+   */
+  void Send(ActionFunc func)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      mActions.push_back(std::move(func));
+
+      if (mRunning || mFailed)
+      {
+        return;
+      }
+
+      mRunning = true;
+    }
+
+    mExecutor.Execute([this]() { drain(); });
+  }
+
+  /**
+   * Blocks until every action sent so far has run, or the agent failed.
+   */
+  void Await()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this]() { return idle(); });
+  }
+
+  /**
+   * Works like Await() but gives up after the timeout.
+   *
+   * @param timeout How long to wait.
+   *
+   * @return `true` if the agent became idle else `false`.
+   */
+  template<typename Rep, typename Period>
+  bool AwaitFor(const std::chrono::duration<Rep, Period>& timeout)
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mCondition.wait_for(lock, timeout, [this]() { return idle(); });
+  }
+
+  /**
+   * @return The error of the most recent action which threw or produced an
+   *         invalid value, or null if there was none.
+   */
+  std::exception_ptr Error()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mError;
+  }
+
+  /**
+   * @return `true` if the agent is stopped because of an error, which is
+   *         only possible with AgentErrorMode::Fail.
+   */
+  bool Failed()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mFailed;
+  }
+
+  /**
+   * Clears the error of a failed agent, sets its value, and resumes
+   * running actions.
+   *
+   * @param newValue The new value. Not validated.
+   * @param clearActions Whether to discard the actions queued while the
+   *        agent was stopped.
+   *
+   * @throws std::logic_error If the agent has not failed.
+   */
+  void Restart(const T& newValue, bool clearActions = false)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+
+      if (!mFailed)
+      {
+        throw std::logic_error("only a failed agent can be restarted");
+      }
+
+      mState.Reset(newValue);
+      mError = nullptr;
+      mFailed = false;
+
+      if (clearActions)
+      {
+        mActions.clear();
+      }
+
+      if (mActions.empty())
+      {
+        mCondition.notify_all();
+        return;
+      }
+
+      mRunning = true;
+    }
+
+    mExecutor.Execute([this]() { drain(); });
+  }
+
+private:
+
+  /**
+   * Runs the queued actions, including those sent while running, until the
+   * queue is empty or an action fails the agent.
+   */
+  void drain()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (!mActions.empty() && !mFailed)
+    {
+      ActionFunc func = std::move(mActions.front());
+      mActions.pop_front();
+
+      lock.unlock();
+      std::exception_ptr error = apply(func);
+      lock.lock();
+
+      if (error)
+      {
+        mError = error;
+        mFailed = mErrorMode == AgentErrorMode::Fail;
+      }
+    }
+
+    mRunning = false;
+    mCondition.notify_all();
+  }
+
+  /**
+   * Runs one action against the current value.
+   *
+   * @return The error, if the action threw or produced an invalid value.
+   */
+  std::exception_ptr apply(ActionFunc& func)
+  {
+    try
+    {
+      T newValue = func(mState.Value());
+
+      if (!InvokeValidator(mValidator, newValue))
+      {
+        throw std::invalid_argument("agent action produced an invalid value");
+      }
+
+      mState.Reset(std::move(newValue));
+      return nullptr;
+    }
+    catch (...)
+    {
+      return std::current_exception();
+    }
+  }
+
+  bool idle() const
+  {
+    return !mRunning && (mActions.empty() || mFailed);
+  }
+
+  Atom<T, LockPolicy> mState;
+
+  Validator mValidator;
+
+  const AgentErrorMode mErrorMode;
+
+  Executor& mExecutor;
+
+  std::mutex mMutex;
+
+  std::condition_variable mCondition;
+
+  std::deque<ActionFunc> mActions;
+
+  bool mRunning{ false };
+
+  bool mFailed{ false };
+
+  std::exception_ptr mError;
+};
@@ -1,15 +1,155 @@
 #pragma once
 
-#if __cplusplus == 201406
-  #define CPP17
-#endif
-
-#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <exception>
 #include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <AtomStats.h>
+#include <Backoff.h>
+#include <LockPolicy.h>
+#include <ParkingLot.h>
+#include <Watches.h>
+
+/**
+ * Lazily queries `std::atomic<T>` so that it is only instantiated for types
+ * that are known to be trivially copyable.
+ */
+template<typename T>
+struct IsAlwaysLockFree
+  : std::integral_constant<bool, std::atomic<T>::is_always_lock_free>
+{
+};
+
+/**
+ * Determines whether an Atom of the given type can be implemented on top of
+ * a lock-free `std::atomic<T>` rather than a mutex.
+ *
+ * The value type must be trivially copyable and the platform must provide
+ * a lock-free `std::atomic` of that size.
+ */
+template<typename T>
+struct IsLockFreeAtom
+  : std::conjunction<std::is_trivially_copyable<T>, IsAlwaysLockFree<T>>
+{
+};
+
+/**
+ * Determines whether an Atom of the given type uses LockFree when no lock
+ * policy is given explicitly.
+ *
+ * Only integers, enums, and pointers qualify. For these comparing the bytes
+ * of two values, as the LockFree atom does, is the same as `operator==`.
+ * Floating point values (`0.0` and `-0.0`), structs with padding, and
+ * structs with their own `operator==` would compare differently, so they
+ * must ask for LockFree explicitly.
+ */
+template<typename T>
+struct IsDefaultLockFree
+  : std::conjunction<std::is_scalar<T>,
+                     std::has_unique_object_representations<T>,
+                     IsLockFreeAtom<T>>
+{
+};
+
+/**
+ * The lock policy used by Atom when none is given explicitly: LockFree for
+ * integers, enums, and pointers (see IsDefaultLockFree), otherwise
+ * ExclusiveLock.
+ *
+ * @note The LockFree atom keeps no version, so an atom which needs
+ *       Version(), WaitChange(), MultiAtom, or CachedReader must name its
+ *       lock policy.
+ */
+template<typename T>
+using DefaultLockPolicy = typename std::conditional<
+  IsDefaultLockFree<T>::value, LockFree, ExclusiveLock>::type;
+
+/**
+ * Calls the validator of an Atom. An empty `std::function` accepts every
+ * value, which spares atoms without a validator an indirect call.
+ */
+template<typename Validator, typename T>
+inline bool InvokeValidator(Validator& validator, const T& newValue)
+{
+  return validator(newValue);
+}
+
+template<typename T>
+inline bool InvokeValidator(std::function<bool(const T&)>& validator, const T& newValue)
+{
+  return !validator || validator(newValue);
+}
+
+/**
+ * Removes the update function overloads of Atom::Reset() from overload
+ * resolution unless `F` can actually be called with the current value.
+ */
+template<typename F, typename T>
+using EnableIfUpdateFunc = typename std::enable_if<
+  std::is_invocable<F&, const T&>::value>::type;
+
+/**
+ * Removes the backoff overloads of Atom::Swap() from overload resolution
+ * unless `B` is a backoff strategy.
+ */
+template<typename B>
+using EnableIfBackoff = typename std::enable_if<IsBackoff<B>::value>::type;
+
+/**
+ * How the update functions given to Atom::ResetBatch() and Atom::SwapBatch()
+ * are validated.
+ */
+enum class BatchValidation
+{
+  /**
+   * Apply every function, then validate the final value once. If it fails
+   * validation none of the functions take effect.
+   */
+  Once,
+
+  /**
+   * Validate the result of every function. A function whose result fails
+   * validation is skipped and the next function sees the last valid value,
+   * exactly as if each function had been passed to Reset() on its own.
+   */
+  EachStep
+};
+
+/**
+ * Applies a range of update functions to a copy of the current value, in
+ * order, and returns the result.
+ */
+template<typename T, typename Range, typename IsValid>
+T ApplyUpdateBatch(const Range& funcs, const T& currentValue,
+                   BatchValidation validation, IsValid&& isValid)
+{
+  T workingValue(currentValue);
+
+  for (auto& func : funcs)
+  {
+    T newValue = func(static_cast<const T&>(workingValue));
+
+    if (validation == BatchValidation::EachStep && !isValid(newValue))
+    {
+      continue;
+    }
+
+    workingValue = std::move(newValue);
+  }
+
+  return workingValue;
+}
 
-#ifdef CPP17
-#include <shared_mutex>
-#endif
+class MultiAtom;
 
 /**
  * Atoms provide a way to manage shared, synchronous, independent state.
@@ -29,10 +169,44 @@
  * Reset(), and Swap(). The differences relate to how the new value is
  * calculated and how aggressively the atom is locked.
  *
+ * How the value is protected is chosen by the LockPolicy template
+ * parameter, so every atom can be tuned to its own read/write mix. See
+ * LockPolicy.h for the shipped policies. Small, trivially copyable values
+ * (integers, enums, pointers, flags) default to the lock-free specialization
+ * Atom<T, LockFree>; everything else defaults to ExclusiveLock.
+ *
+ * Every method which takes a function accepts any callable directly, so
+ * lambdas are inlined rather than wrapped in a `std::function`. The
+ * function typedefs below document the expected signatures. The validator
+ * is stored as a `std::function` unless a different Validator type is given;
+ * a stateless functor type makes validation a compile-time, inlined call.
+ *
+ * What the atom records about its own use is chosen by the StatsPolicy
+ * template parameter. The default, NoStats, records nothing and costs
+ * nothing; AtomStats records lock wait and hold times, Swap() retries,
+ * validation failures, and copies. See AtomStats.h.
+ *
+ * A thread can block until the value satisfies a predicate with
+ * WaitUntil() or WaitFor(), or until any write with WaitChange(). Waiting
+ * threads are parked in the global ParkingLot and are only woken by writes;
+ * writes pay nothing beyond an atomic load while nobody waits.
+ *
+ * Watchers added with AddWatch() are told the old and new value after every
+ * successful write, once the lock has been released, either inline or on
+ * an Executor.
+ *
+ * @tparam T The type of the value.
+ * @tparam LockPolicy How the value is protected. See LockPolicy.h.
+ * @tparam Validator The type of the validation function.
+ * @tparam StatsPolicy What to record about the atom's use. See AtomStats.h.
+ *
  * @see http://clojure.org/atoms Clojure Atoms
  * @see http://clojure.org/state Values and Change - Clojure's approach to Identity and State
  */
-template<typename T>
+template<typename T,
+         typename LockPolicy = DefaultLockPolicy<T>,
+         typename Validator = std::function<bool(const T&)>,
+         typename StatsPolicy = NoStats>
 class Atom
 {
 public:
@@ -78,6 +252,14 @@ public:
    **/
   typedef std::function<void(T& currentValue)> ModifyFunc;
 
+  /**
+   * A function told about a change of the value. See AddWatch().
+   *
+   * @param oldValue The value before the change.
+   * @param newValue The value after the change.
+   **/
+  typedef typename Watches<T>::WatchFunc WatchFunc;
+
   /**
    * Constructs a new Atom with the given initial value and optional
    * validation function.
@@ -85,8 +267,20 @@ public:
    * @param initialValue The initial value.
    * @param validator Function to be used when validating a new value.
    */
-  explicit Atom(const T& initialValue, ValidateFunc validator = [](const T&){ return true; })
-    : mValue(initialValue)
+  explicit Atom(const T& initialValue, Validator validator = Validator())
+    : mState{ initialValue, 0 }
+    , mValidator(validator)
+    {
+    }
+
+  /**
+   * Constructs a new Atom by moving in the given initial value.
+   *
+   * @param initialValue The initial value.
+   * @param validator Function to be used when validating a new value.
+   */
+  explicit Atom(T&& initialValue, Validator validator = Validator())
+    : mState{ std::move(initialValue), 0 }
     , mValidator(validator)
     {
     }
@@ -102,13 +296,19 @@ public:
    */
   void operator = (const T& newValue)
   {
-#ifdef CPP17
-    std::unique_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
+    write([&](State& state){ state.set(newValue); });
+  }
 
-    mValue = newValue;
+  /**
+   * Atomically overwrite the current value by moving in the new value.
+   *
+   * @note Does not perform validation of the new value.
+   *
+   * @param newValue The intended new value.
+   */
+  void operator = (T&& newValue)
+  {
+    write([&](State& state){ state.set(std::move(newValue)); });
   }
 
   /**
@@ -120,13 +320,7 @@ public:
    */
   bool operator == (const T& otherValue)
   {
-#ifdef CPP17
-    std::shared_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    return mValue == otherValue;
+    return read([&](const State& state){ return state.value == otherValue; });
   }
 
   /**
@@ -138,13 +332,7 @@ public:
    */
   bool operator != (const T& otherValue)
   {
-#ifdef CPP17
-    std::shared_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    return mValue != otherValue;
+    return read([&](const State& state){ return state.value != otherValue; });
   }
 
   /**
@@ -154,13 +342,7 @@ public:
    */
   T Value()
   {
-#ifdef CPP17
-    std::shared_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    return mValue;
+    return read([this](const State& state){ return copyOf(state); });
   }
 
   /**
@@ -174,15 +356,10 @@ public:
    *
    * @return `true` if the comparison is successful else `false`.
    */
-  bool Compare(ComparatorFunc func)
+  template<typename F>
+  bool Compare(F&& func)
   {
-#ifdef CPP17
-    std::shared_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    return func(mValue);
+    return read([&](const State& state){ return func(state.value); });
   }
 
   /**
@@ -198,21 +375,115 @@ public:
    */
   bool CompareAndSet(const T& oldValue, const T& newValue)
   {
-#ifdef CPP17
-    std::unique_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
+    return write([&](State& state)
+    {
+      if (state.value == oldValue && isValid(newValue))
+      {
+        state.set(newValue);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    });
+  }
+
+  /**
+   * Atomically obtain the current version of the value. The version starts
+   * at zero and increases by one every time the value is written.
+   *
+   * @return The current version.
+   */
+  uint64_t Version()
+  {
+    return read([](const State& state){ return state.version; });
+  }
+
+  /**
+   * Obtain the version of the value as of the last completed write without
+   * taking the lock. A single atomic load, so cheap enough to poll on every
+   * read; see CachedReader.
+   *
+   * @note While a write is being published the epoch and Version() may
+   *       briefly disagree. Tag cached copies with the version returned by
+   *       ValueWithVersion(), never with the epoch.
+   *
+   * @return The version as of the last completed write.
+   */
+  uint64_t Epoch() const
+  {
+    return mEpoch.load(std::memory_order_acquire);
+  }
 
-    if (mValue == oldValue && isValid(newValue))
+  /**
+   * Atomically obtain a copy of the current value along with its version.
+   *
+   * @return The current value and the version it was written at.
+   */
+  std::pair<T, uint64_t> ValueWithVersion()
+  {
+    return read([this](const State& state)
     {
-      mValue = newValue;
-      return true;
-    }
-    else
+      return std::pair<T, uint64_t>(copyOf(state), state.version);
+    });
+  }
+
+  /**
+   * Atomically sets the value of atom to the new value if and only if the
+   * atom has not been written since the given version was observed and the
+   * new value successfully validates against the (optional) validator given
+   * at construction.
+   *
+   * Unlike CompareAndSet() this never compares values, so the check takes
+   * constant time no matter how large the value is.
+   *
+   * @param version The expected current version, usually obtained from
+   *        ValueWithVersion().
+   * @param newValue The intended new value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  bool CompareAndSetVersion(uint64_t version, const T& newValue)
+  {
+    return write([&](State& state)
     {
-      return false;
-    }
+      if (state.version == version && isValid(newValue))
+      {
+        state.set(newValue);
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    });
+  }
+
+  /**
+   * Atomically moves the new value in if and only if the atom has not been
+   * written since the given version was observed and the new value
+   * successfully validates. The new value is left untouched on failure.
+   *
+   * @param version The expected current version.
+   * @param newValue The intended new value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  bool CompareAndSetVersion(uint64_t version, T&& newValue)
+  {
+    return write([&](State& state)
+    {
+      if (state.version == version && isValid(newValue))
+      {
+        state.set(std::move(newValue));
+        return true;
+      }
+      else
+      {
+        return false;
+      }
+    });
   }
 
   /**
@@ -227,25 +498,103 @@ public:
    */
   T Reset(const T& newValue)
   {
-#ifdef CPP17
-    std::unique_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
+    return write([&](State& state) -> T
+    {
+      if (isValid(newValue))
+      {
+        state.set(newValue);
+      }
 
-    if (isValid(newValue))
+      return copyOf(state);
+    });
+  }
+
+  /**
+   * Atomically moves the new value in without regard for the current value so
+   * long as the new value successfully validates against the (optional)
+   * validator given at construction.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The final value of the atom after all operations and
+   *         validations are complete.
+   */
+  T Reset(T&& newValue)
+  {
+    return write([&](State& state) -> T
+    {
+      if (isValid(newValue))
+      {
+        state.set(std::move(newValue));
+      }
+
+      return copyOf(state);
+    });
+  }
+
+  /**
+   * Constructs a new value from the given arguments and, if it successfully
+   * validates against the (optional) validator given at construction, moves
+   * it in. The value is constructed before the write lock is taken.
+   *
+   * @param args The arguments passed to the constructor of the value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  template<typename... Args>
+  bool Emplace(Args&&... args)
+  {
+    T newValue(std::forward<Args>(args)...);
+
+    if (!isValid(newValue))
     {
-      mValue = newValue;
+      return false;
     }
 
-    return mValue;
+    write([&](State& state){ state.set(std::move(newValue)); });
+    return true;
+  }
+
+  /**
+   * Atomically moves the new value in and the previous value out. Neither
+   * value is copied, so handing off large buffers costs the same as handing
+   * off small ones.
+   *
+   * @note Does not perform validation of the new value.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The previous value.
+   */
+  T Exchange(T&& newValue)
+  {
+    return write([&](State& state)
+    {
+      state.remember();
+      T oldValue(std::move(state.value));
+      state.set(std::move(newValue));
+      return oldValue;
+    });
+  }
+
+  /**
+   * Atomically moves the current value out, leaving a default constructed
+   * value in its place.
+   *
+   * @note Does not perform validation of the default constructed value.
+   *
+   * @return The previous value.
+   */
+  T Take()
+  {
+    return Exchange(T());
   }
 
   /**
    * Atomically sets the value of atom using the given block. The current
-   * value will be passed to the block and thehe new value will be validated
-   * against the (optional) validator proc given at construction. If validation
-   * fails the value will not be changed.
+   * value will be passed to the block and the new value will be validated
+   * against the (optional) validator proc given at construction. If
+   * validation fails the value will not be changed.
    *
    * This method locks much more aggressively than Swap() but guarantees that
    * the update function will be run only once.
@@ -261,22 +610,20 @@ public:
    * @return The current value after the update has occurred (or been rejected
    *         as invalid).
    */
-  T Reset(UpdateFunc func)
+  template<typename F, typename = EnableIfUpdateFunc<F, T>>
+  T Reset(F&& func)
   {
-#ifdef CPP17
-    std::unique_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    T newValue = func(mValue);
-
-    if (isValid(newValue))
+    return write([&](State& state) -> T
     {
-      mValue = newValue;
-    }
+      T newValue = func(state.value);
 
-    return mValue;
+      if (isValid(newValue))
+      {
+        state.set(std::move(newValue));
+      }
+
+      return copyOf(state);
+    });
   }
 
   /**
@@ -291,45 +638,122 @@ public:
    *
    * Since a write lock also blocks readers, this method aggressively seeks to
    * minimize the length of time in the write lock. Internally it reads the
-   * current value, applies the block to it, and attempts to CompareAndSet() it
-   * in. Since another thread may have changed the value in the intervening time
-   * it may have to retry, and does so in a spin loop. The net effect is that
-   * the value will always be the result of the application of the supplied
-   * lambda to the current value, atomically. However, because the lambda may be
-   * called multiple times, it must be free of side effects.
+   * current value and version, applies the block to the value, and attempts
+   * to CompareAndSetVersion() it in. Since another thread may have changed
+   * the value in the intervening time it may have to retry, and does so in a
+   * spin loop. Checking the version rather than comparing values keeps the
+   * write lock hold time constant no matter how large the value is. The net
+   * effect is that the value will always be the result of the application
+   * of the supplied lambda to the current value, atomically. However,
+   * because the lambda may be called multiple times, it must be free of side
+   * effects.
    *
    * @note If the new value fails validation (which can only happen when a
-   *       custom validator is provided at construction) the CompareAndSet()
-   *       will fail, triggering another iteration of the spin loop. This
-   *       has the potential to cause an infinite loop. Care must be taken
-   *       when using this method and a custom validator.
+   *       custom validator is provided at construction) the
+   *       CompareAndSetVersion() will fail, triggering another iteration of
+   *       the spin loop. This has the potential to cause an infinite loop.
+   *       Care must be taken when using this method and a custom validator.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename F>
+  T Swap(F&& func, int maxAttempts = 0)
+  {
+    return Swap(func, NoBackoff(), maxAttempts);
+  }
+
+  /**
+   * Works exactly like Swap() but calls the given backoff strategy after
+   * every failed attempt. Under heavy contention backing off keeps the
+   * retrying threads from hammering the lock. See Backoff.h.
    *
    * @param func The lambda used to calculate the new value.
+   * @param backoff The strategy called with the number of attempts made so
+   *        far after every failed attempt.
    * @param maxAttempts The maximum number of times the spin loop may run
    *        before rejecting the update.
    *
    * @return The current value after the update has occurred (or been rejected
    *         as invalid).
    */
-  T Swap(UpdateFunc func, int maxAttempts = 0)
+  template<typename F, typename Backoff, typename = EnableIfBackoff<Backoff>>
+  T Swap(F&& func, Backoff backoff, int maxAttempts = 0)
   {
-    T oldValue, newValue;
     int attempts{ 0 };
 
     for (;;)
     {
-      oldValue = Value();
-      newValue = func(oldValue);
+      std::pair<T, uint64_t> current = ValueWithVersion();
+      T newValue = func(current.first);
       attempts++;
 
-      if (CompareAndSet(oldValue, newValue)
+      if (CompareAndSetVersion(current.second, newValue)
           || (maxAttempts > 0 && attempts >= maxAttempts))
       {
-        break;
+        mStats.RecordSwap(attempts);
+        return newValue;
       }
+
+      backoff(attempts);
+    }
+  }
+
+  /**
+   * Works like Swap() but gives up once the deadline has passed rather than
+   * after a number of attempts. At least one attempt is always made.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param deadline The point in time after which no further attempt is made.
+   * @param backoff The strategy called after every failed attempt.
+   *
+   * @return The new value if the update occurred, otherwise nothing.
+   */
+  template<typename F, typename Clock, typename Duration, typename Backoff = NoBackoff>
+  std::optional<T> SwapUntil(F&& func,
+                             const std::chrono::time_point<Clock, Duration>& deadline,
+                             Backoff backoff = Backoff())
+  {
+    for (int attempts = 1; ; attempts++)
+    {
+      std::pair<T, uint64_t> current = ValueWithVersion();
+      T newValue = func(current.first);
+
+      if (CompareAndSetVersion(current.second, newValue))
+      {
+        mStats.RecordSwap(attempts);
+        return newValue;
+      }
+
+      if (Clock::now() >= deadline)
+      {
+        mStats.RecordSwap(attempts);
+        return std::nullopt;
+      }
+
+      backoff(attempts);
     }
+  }
 
-    return newValue;
+  /**
+   * Works like SwapUntil() with a deadline relative to now.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param timeout How long to keep trying.
+   * @param backoff The strategy called after every failed attempt.
+   *
+   * @return The new value if the update occurred, otherwise nothing.
+   */
+  template<typename F, typename Rep, typename Period, typename Backoff = NoBackoff>
+  std::optional<T> SwapFor(F&& func,
+                           const std::chrono::duration<Rep, Period>& timeout,
+                           Backoff backoff = Backoff())
+  {
+    return SwapUntil(func, std::chrono::steady_clock::now() + timeout, backoff);
   }
 
   /**
@@ -339,15 +763,10 @@ public:
    *
    * @param func The lambda used to operate with the current value.
    */
-  void With(WithFunc func)
+  template<typename F>
+  void With(F&& func)
   {
-#ifdef CPP17
-    std::shared_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    func(mValue);
+    read([&](const State& state){ func(state.value); });
   }
 
   /**
@@ -363,23 +782,1225 @@ public:
    *
    * @return The final value of the atom after all operations are complete.
    */
-  T Modify(ModifyFunc func)
+  template<typename F>
+  T Modify(F&& func)
   {
-#ifdef CPP17
-    std::unique_lock<std::shared_mutex> lock(mMutex);
-#else
-    std::lock_guard<std::mutex> rlock(mMutex);
-#endif
-
-    func(mValue);
-
-    return mValue;
+    return write([&](State& state) -> T
+    {
+      state.remember();
+      func(state.value);
+      state.version++;
+      return copyOf(state);
+    });
   }
 
-protected:
-
   /**
-   * Validates the new value against the validator function.
+   * Atomically applies a range of update functions, in order, under a single
+   * acquisition of the write lock. Each function is passed the result of the
+   * previous one. Bulk updates pay for one lock round-trip and one version
+   * increment per batch rather than per function.
+   *
+   * Like Reset() every function is guaranteed to run exactly once, and the
+   * write lock is held while they run.
+   *
+   * @param funcs The update functions, e.g. a `std::vector<UpdateFunc>`.
+   * @param validation Whether to validate only the final value or the result
+   *        of every function. See BatchValidation.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename Range>
+  T ResetBatch(const Range& funcs, BatchValidation validation = BatchValidation::Once)
+  {
+    return write([&](State& state) -> T
+    {
+      T newValue = ApplyUpdateBatch(funcs, state.value, validation,
+                                    [this](const T& value){ return isValid(value); });
+
+      if (isValid(newValue))
+      {
+        state.set(std::move(newValue));
+      }
+
+      return copyOf(state);
+    });
+  }
+
+  /**
+   * Works like ResetBatch() but takes the functions as an initializer list.
+   */
+  T ResetBatch(std::initializer_list<UpdateFunc> funcs,
+               BatchValidation validation = BatchValidation::Once)
+  {
+    return ResetBatch<std::initializer_list<UpdateFunc>>(funcs, validation);
+  }
+
+  /**
+   * Atomically applies a range of update functions, in order, the way Swap()
+   * applies one: the functions run outside of the write lock against a copy
+   * of the current value and the result is installed with a single
+   * CompareAndSetVersion(). If another thread wrote in the meantime the whole
+   * batch is retried, so the functions must be free of side effects.
+   *
+   * @param funcs The update functions, e.g. a `std::vector<UpdateFunc>`.
+   * @param validation Whether to validate only the final value or the result
+   *        of every function. See BatchValidation.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename Range>
+  T SwapBatch(const Range& funcs,
+              BatchValidation validation = BatchValidation::Once,
+              int maxAttempts = 0)
+  {
+    return Swap([&](const T& currentValue)
+                {
+                  return ApplyUpdateBatch(funcs, currentValue, validation,
+                                          [this](const T& value){ return isValid(value); });
+                }, maxAttempts);
+  }
+
+  /**
+   * Works like SwapBatch() but takes the functions as an initializer list.
+   */
+  T SwapBatch(std::initializer_list<UpdateFunc> funcs,
+              BatchValidation validation = BatchValidation::Once,
+              int maxAttempts = 0)
+  {
+    return SwapBatch<std::initializer_list<UpdateFunc>>(funcs, validation, maxAttempts);
+  }
+
+  /**
+   * Blocks the calling thread until the value satisfies the predicate. The
+   * thread is parked rather than polling and is only woken by writes.
+   *
+   * @param pred Called with the current value after every write until it
+   *        returns `true`.
+   *
+   * @return The first value observed which satisfied the predicate.
+   */
+  template<typename F>
+  T WaitUntil(F&& pred)
+  {
+    return *waitUntil(pred, std::optional<ParkingLot::Clock::time_point>());
+  }
+
+  /**
+   * Works like WaitUntil() but gives up after the timeout.
+   *
+   * @param pred Called with the current value after every write until it
+   *        returns `true`.
+   * @param timeout How long to wait.
+   *
+   * @return The first value observed which satisfied the predicate, or
+   *         nothing if the timeout passed first.
+   */
+  template<typename F, typename Rep, typename Period>
+  std::optional<T> WaitFor(F&& pred, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    auto deadline = ParkingLot::Clock::now()
+                  + std::chrono::duration_cast<ParkingLot::Clock::duration>(timeout);
+
+    return waitUntil(pred, std::optional<ParkingLot::Clock::time_point>(deadline));
+  }
+
+  /**
+   * Blocks the calling thread until the atom is written after the given
+   * version, for example one obtained from ValueWithVersion().
+   *
+   * @param lastVersion The version the caller has already seen.
+   *
+   * @return The current version, which is different from `lastVersion`.
+   */
+  uint64_t WaitChange(uint64_t lastVersion)
+  {
+    for (;;)
+    {
+      uint64_t version = Version();
+
+      if (version != lastVersion)
+      {
+        return version;
+      }
+
+      park(version, std::optional<ParkingLot::Clock::time_point>());
+    }
+  }
+
+  /**
+   * Adds a watcher which is called with the old and new value after every
+   * successful write. Adding a watcher with the key of an existing watcher
+   * replaces it.
+   *
+   * Watchers are called after the write lock has been released, so a
+   * watcher may use the atom, but writes on different threads may report
+   * their changes in a different order than they were made. With
+   * WatchMode::Coalesce a watcher is never called concurrently with itself
+   * and always sees the newest value last.
+   *
+   * An exception thrown by a watcher is caught and dropped. It neither
+   * fails the write nor escapes into the executor's thread.
+   *
+   * Watchers of atoms updated together by MultiAtom are called once all of
+   * the atoms are unlocked.
+   *
+   * @param key Identifies the watcher, e.g. for RemoveWatch().
+   * @param func Called as `func(oldValue, newValue)`.
+   * @param executor Where the watcher is called. By default it is called
+   *        inline by the thread which wrote the value.
+   * @param mode Whether changes made while the watcher is busy are merged.
+   */
+  void AddWatch(const std::string& key,
+                WatchFunc func,
+                Executor& executor = InlineExecutor::Instance(),
+                WatchMode mode = WatchMode::EveryChange)
+  {
+    mWatches.Add(key, std::move(func), executor, mode);
+  }
+
+  /**
+   * Removes the watcher with the given key. A call which is already running
+   * or which has been handed to an executor may still complete.
+   *
+   * @param key Identifies the watcher.
+   *
+   * @return `true` if there was such a watcher else `false`.
+   */
+  bool RemoveWatch(const std::string& key)
+  {
+    return mWatches.Remove(key);
+  }
+
+  /**
+   * Obtain what the atom has recorded about its use so far. Always empty
+   * unless the atom was declared with a recording StatsPolicy such as
+   * AtomStats.
+   *
+   * @return A snapshot of the statistics.
+   */
+  AtomStatistics Statistics() const
+  {
+    return mStats.Snapshot();
+  }
+
+  /**
+   * Sets every recorded statistic back to zero, e.g. after scraping them.
+   */
+  void ClearStatistics()
+  {
+    mStats.Clear();
+  }
+
+protected:
+
+  /**
+   * Validates the new value against the validator function.
+   *
+   * @param newValue The value to be validated.
+   *
+   * @return `true` is the new value is valid else `false`.
+   */
+  bool isValid(const T& newValue)
+  {
+    if (InvokeValidator(mValidator, newValue))
+    {
+      return true;
+    }
+
+    mStats.RecordValidationFailure();
+    return false;
+  }
+
+private:
+
+  friend class MultiAtom;
+
+  /**
+   * The value together with the number of times it has been written. Both
+   * are protected by the lock policy as a unit so a reader always sees a
+   * matching pair.
+   */
+  struct State
+  {
+    T value;
+    uint64_t version;
+
+    /**
+     * Where a watched write wants the old value copied, or `nullptr`.
+     */
+    std::optional<T>* previous{ nullptr };
+
+    void set(const T& newValue)
+    {
+      remember();
+      value = newValue;
+      version++;
+    }
+
+    void set(T&& newValue)
+    {
+      remember();
+      value = std::move(newValue);
+      version++;
+    }
+
+    /**
+     * Copies the value for a watched write before it is first changed.
+     */
+    void remember()
+    {
+      if (previous != nullptr && !*previous)
+      {
+        previous->emplace(value);
+      }
+    }
+  };
+
+  /**
+   * Runs the function under the read lock, by way of the statistics policy.
+   */
+  template<typename F>
+  auto read(F&& func) -> decltype(func(std::declval<const State&>()))
+  {
+    return mStats.Read(mLock, static_cast<const State&>(mState), func);
+  }
+
+  /**
+   * Runs the function under the write lock, by way of the statistics policy,
+   * and publishes the resulting version as the new epoch.
+   */
+  template<typename F>
+  auto write(F&& func) -> decltype(func(std::declval<State&>()))
+  {
+    if (!mWatches.Empty())
+    {
+      return watchedWrite(func);
+    }
+
+    WaiterNotifier notifier(*this);
+    return publishingWrite(func);
+  }
+
+  template<typename F>
+  auto publishingWrite(F& func) -> decltype(func(std::declval<State&>()))
+  {
+    return mStats.Write(mLock, mState, [&](State& state) -> decltype(func(state))
+    {
+      EpochPublisher publisher(mEpoch, state);
+      return func(state);
+    });
+  }
+
+  /**
+   * Works like write() but records the old and new value of a successful
+   * write and tells the watchers about them once the lock is released.
+   */
+  template<typename F>
+  auto watchedWrite(F& func) -> decltype(func(std::declval<State&>()))
+  {
+    typedef decltype(func(std::declval<State&>())) Result;
+
+    Change change;
+
+    if constexpr (std::is_void_v<Result>)
+    {
+      recordingWrite(func, change);
+      notifyWatches(change);
+    }
+    else
+    {
+      Result result = recordingWrite(func, change);
+      notifyWatches(change);
+      return result;
+    }
+  }
+
+  /**
+   * The old and new value of a write, if it changed the value.
+   */
+  struct Change
+  {
+    std::optional<T> oldValue;
+    std::optional<T> newValue;
+    uint64_t version{ 0 };
+  };
+
+  /**
+   * Has the state copy the old value the first time the write function
+   * changes it, so a write which changes nothing (a failed CompareAndSet(),
+   * a rejected Reset()) copies nothing. Commit() then copies the new value,
+   * while the lock is still held.
+   */
+  class ChangeRecorder
+  {
+  public:
+
+    ChangeRecorder(Change& change, State& state)
+      : mChange(change)
+      , mState(state)
+      {
+        mState.previous = &mChange.oldValue;
+      }
+
+    ~ChangeRecorder()
+    {
+      mState.previous = nullptr;
+    }
+
+    void Commit()
+    {
+      if (mChange.oldValue)
+      {
+        mChange.newValue.emplace(mState.value);
+        mChange.version = mState.version;
+      }
+    }
+
+  private:
+
+    Change& mChange;
+    State& mState;
+  };
+
+  void notifyWatches(const Change& change)
+  {
+    if (change.newValue)
+    {
+      mWatches.Notify(*change.oldValue, *change.newValue, change.version);
+    }
+  }
+
+  /**
+   * Works like write() but, if the atom is watched, records the old and new
+   * value of a successful write in the change instead of telling the
+   * watchers. Lets MultiAtom tell them once every atom is unlocked.
+   */
+  template<typename F>
+  auto recordingWrite(F& func, Change& change) -> decltype(func(std::declval<State&>()))
+  {
+    typedef decltype(func(std::declval<State&>())) Result;
+
+    WaiterNotifier notifier(*this);
+
+    if (mWatches.Empty())
+    {
+      return publishingWrite(func);
+    }
+
+    auto recorded = [&](State& state) -> Result
+    {
+      ChangeRecorder recorder(change, state);
+
+      if constexpr (std::is_void_v<Result>)
+      {
+        func(state);
+        recorder.Commit();
+      }
+      else
+      {
+        Result result = func(state);
+        recorder.Commit();
+        return result;
+      }
+    };
+
+    return publishingWrite(recorded);
+  }
+
+  /**
+   * The implementation of WaitUntil() and WaitFor(). The predicate is
+   * checked under the read lock and the version read alongside it is the
+   * one waited on, so a write between the check and parking is not missed.
+   */
+  template<typename F>
+  std::optional<T> waitUntil(F& pred, std::optional<ParkingLot::Clock::time_point> deadline)
+  {
+    for (;;)
+    {
+      uint64_t version{ 0 };
+
+      std::optional<T> match = read([&](const State& state) -> std::optional<T>
+      {
+        version = state.version;
+
+        if (pred(static_cast<const T&>(state.value)))
+        {
+          return copyOf(state);
+        }
+
+        return std::nullopt;
+      });
+
+      if (match)
+      {
+        return match;
+      }
+
+      if (!park(version, deadline))
+      {
+        return std::nullopt;
+      }
+    }
+  }
+
+  /**
+   * Parks the calling thread until the epoch differs from the given
+   * version.
+   *
+   * @return `false` if the deadline passed first else `true`.
+   */
+  bool park(uint64_t version, std::optional<ParkingLot::Clock::time_point> deadline)
+  {
+    mWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+    auto unchanged = [&]() { return mEpoch.load(std::memory_order_seq_cst) == version; };
+
+    bool changed = deadline ? ParkingLot::ParkUntil(this, unchanged, *deadline)
+                            : ParkingLot::Park(this, unchanged);
+
+    mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    return changed;
+  }
+
+  /**
+   * Wakes parked threads once a write has released the lock.
+   */
+  class WaiterNotifier
+  {
+  public:
+
+    explicit WaiterNotifier(Atom& atom)
+      : mAtom(atom)
+      {
+      }
+
+    ~WaiterNotifier()
+    {
+      if (mAtom.mWaiters.load(std::memory_order_seq_cst) != 0)
+      {
+        ParkingLot::UnparkAll(&mAtom);
+      }
+    }
+
+  private:
+
+    Atom& mAtom;
+  };
+
+  /**
+   * Copies the value out of the state, counting the copy.
+   */
+  T copyOf(const State& state)
+  {
+    mStats.RecordCopy();
+    return state.value;
+  }
+
+  /**
+   * Stores the version of the state in the epoch once the write function
+   * returns, while the write lock is still held.
+   */
+  class EpochPublisher
+  {
+  public:
+
+    EpochPublisher(std::atomic<uint64_t>& epoch, const State& state)
+      : mEpoch(epoch)
+      , mState(state)
+      {
+      }
+
+    ~EpochPublisher()
+    {
+      mEpoch.store(mState.version, std::memory_order_seq_cst);
+    }
+
+  private:
+
+    std::atomic<uint64_t>& mEpoch;
+    const State& mState;
+  };
+
+  State mState;
+
+  std::atomic<uint64_t> mEpoch{ 0 };
+
+  std::atomic<uint32_t> mWaiters{ 0 };
+
+  Watches<T> mWatches;
+
+  Validator mValidator;
+
+  LockPolicy mLock;
+
+  StatsPolicy mStats;
+};
+
+
+/**
+ * An Atom protected by a SeqLock. Intended for read-mostly, trivially
+ * copyable values such as configuration structs: reads never block each
+ * other and writers only make readers retry while publishing.
+ */
+template<typename T>
+using SeqLockAtom = Atom<T, SeqLock>;
+
+/**
+ * An Atom protected by the LeftRight policy. Readers never wait, not even
+ * for a long running Reset(UpdateFunc), at the cost of keeping the value
+ * twice. Cannot be updated by MultiAtom.
+ */
+template<typename T>
+using LeftRightAtom = Atom<T, LeftRight>;
+
+/**
+ * Lock-free specialization of Atom for values which fit into a lock-free
+ * `std::atomic<T>`.
+ *
+ * Reads are a single atomic load, CompareAndSet() is a single hardware
+ * compare-and-swap, and Swap() is a compare-and-swap loop. No mutex is
+ * taken unless the atom is watched, so hot counters and flags do not
+ * serialize on a lock.
+ *
+ * @note CompareAndSet() compares the bit patterns of the values rather than
+ *       calling `operator==`. For integers, enums, and pointers the two are
+ *       equivalent. For floating point values `0.0` and `-0.0` compare
+ *       unequal while two identical `NaN` values compare equal, and for
+ *       structs padding bytes take part. Atom therefore only picks this
+ *       specialization by itself for integers, enums, and pointers.
+ *
+ * @note Because there is no lock which can be held while the update function
+ *       runs, Reset(UpdateFunc) and Modify() are implemented as
+ *       compare-and-swap loops just like Swap(). The update function may be
+ *       called more than once and must be free of side effects.
+ *
+ * @note No version stamp is kept. Version() and CompareAndSetVersion() exist
+ *       to make comparing large values cheap, while CompareAndSet() here is
+ *       already a single instruction.
+ *
+ * @note There is no lock, so a StatsPolicy records Swap() attempts and
+ *       validation failures only.
+ */
+template<typename T, typename Validator, typename StatsPolicy>
+class Atom<T, LockFree, Validator, StatsPolicy>
+{
+  static_assert(IsLockFreeAtom<T>::value,
+                "LockFree requires a trivially copyable, lock-free value type");
+
+public:
+
+  /**
+   * A function used to calculate the new value based on the current value.
+   *
+   * @param currentValue The current value.
+   *
+   * @return The new value which will be validated and possibly saved.
+   */
+  typedef std::function<T(const T& currentValue)> UpdateFunc;
+
+  /**
+   * A function for validating the new value.
+   *
+   * @param newValue The new value.
+   *
+   * @return `true` if the new value is valid else `false`.
+   **/
+  typedef std::function<bool(const T& newValue)> ValidateFunc;
+
+  /**
+   * A function for comparing the current value.
+   *
+   * @param currentValue The current value.
+   *
+   * @return `true` if the comparison is successful else `false`.
+   **/
+  typedef std::function<bool(const T& currentValue)> ComparatorFunc;
+
+  /**
+   * A function for working with the current value without modifying it.
+   *
+   * @param currentValue The current value.
+   **/
+  typedef std::function<void(const T& currentValue)> WithFunc;
+
+  /**
+   * A function for modifying the current value in place.
+   *
+   * @param currentValue The current value.
+   **/
+  typedef std::function<void(T& currentValue)> ModifyFunc;
+
+  /**
+   * A function told about a change of the value. See AddWatch().
+   *
+   * @param oldValue The value before the change.
+   * @param newValue The value after the change.
+   **/
+  typedef typename Watches<T>::WatchFunc WatchFunc;
+
+  /**
+   * Constructs a new Atom with the given initial value and optional
+   * validation function.
+   *
+   * @param initialValue The initial value.
+   * @param validator Function to be used when validating a new value.
+   */
+  explicit Atom(const T& initialValue, Validator validator = Validator())
+    : mValue(initialValue)
+    , mValidator(validator)
+    {
+    }
+
+  virtual ~Atom() {  }
+
+  /**
+   * Atomically overwrite the current value with the new value.
+   *
+   * @note Does not perform validation of the new value.
+   *
+   * @param newValue The intended new value.
+   */
+  void operator = (const T& newValue)
+  {
+    write([&]() -> std::optional<T>
+    {
+      return mValue.exchange(newValue, std::memory_order_acq_rel);
+    });
+  }
+
+  /**
+   * Atomically compare the current value to the given value.
+   *
+   * @param otherValue The value to compare against.
+   *
+   * @return `true` if the values are equal else `false`.
+   */
+  bool operator == (const T& otherValue)
+  {
+    return Value() == otherValue;
+  }
+
+  /**
+   * Atomically compare the current value to the given value.
+   *
+   * @param otherValue The value to compare against.
+   *
+   * @return `true` if the value are not equal else `false`.
+   */
+  bool operator != (const T& otherValue)
+  {
+    return Value() != otherValue;
+  }
+
+  /**
+   * Atomically obtain a copy of the current value.
+   *
+   * @return The current value.
+   */
+  T Value()
+  {
+    return mValue.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Atomically compares the current value using the given block.
+   *
+   * @param func The lambda used to evaluate the current value.
+   *
+   * @return `true` if the comparison is successful else `false`.
+   */
+  template<typename F>
+  bool Compare(F&& func)
+  {
+    return func(Value());
+  }
+
+  /**
+   * Atomically sets the value of atom to the new value if and only if the
+   * current value of the atom is identical to the old value and the new
+   * value successfully validates against the (optional) validator given
+   * at construction.
+   *
+   * @param oldValue The expected current value.
+   * @param newValue The intended new value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  bool CompareAndSet(const T& oldValue, const T& newValue)
+  {
+    if (!isValid(newValue))
+    {
+      return false;
+    }
+
+    return write([&]() -> std::optional<T>
+    {
+      T expected = oldValue;
+
+      if (!mValue.compare_exchange_strong(expected, newValue,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire))
+      {
+        return std::nullopt;
+      }
+
+      return expected;
+    }).has_value();
+  }
+
+  /**
+   * Atomically sets the value of atom to the new value without regard for the
+   * current value so long as the new value successfully validates against the
+   * (optional) validator given at construction.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The final value of the atom after all operations and
+   *         validations are complete.
+   */
+  T Reset(const T& newValue)
+  {
+    if (isValid(newValue))
+    {
+      *this = newValue;
+      return newValue;
+    }
+
+    return Value();
+  }
+
+  /**
+   * Constructs a new value from the given arguments and, if it successfully
+   * validates against the (optional) validator given at construction,
+   * stores it.
+   *
+   * @param args The arguments passed to the constructor of the value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  template<typename... Args>
+  bool Emplace(Args&&... args)
+  {
+    T newValue(std::forward<Args>(args)...);
+
+    if (!isValid(newValue))
+    {
+      return false;
+    }
+
+    *this = newValue;
+    return true;
+  }
+
+  /**
+   * Atomically stores the new value and returns the previous one with a
+   * single hardware exchange.
+   *
+   * @note Does not perform validation of the new value.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The previous value.
+   */
+  T Exchange(const T& newValue)
+  {
+    return *write([&]() -> std::optional<T>
+    {
+      return mValue.exchange(newValue, std::memory_order_acq_rel);
+    });
+  }
+
+  /**
+   * Atomically replaces the current value with a value initialized `T` and
+   * returns the previous one.
+   *
+   * @note Does not perform validation of the value initialized `T`.
+   *
+   * @return The previous value.
+   */
+  T Take()
+  {
+    return Exchange(T());
+  }
+
+  /**
+   * Atomically sets the value of atom using the given block. If validation
+   * fails the value will not be changed.
+   *
+   * @note Unlike the locking Atom the update function may be called more
+   *       than once and must be free of side effects.
+   *
+   * @param func The lambda used to calculate the new value.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename F, typename = EnableIfUpdateFunc<F, T>>
+  T Reset(F&& func)
+  {
+    std::optional<T> result;
+
+    write([&]() -> std::optional<T>
+    {
+      T oldValue = Value();
+
+      for (;;)
+      {
+        result = func(oldValue);
+
+        if (!isValid(*result))
+        {
+          result = oldValue;
+          return std::nullopt;
+        }
+
+        if (mValue.compare_exchange_weak(oldValue, *result,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire))
+        {
+          return oldValue;
+        }
+      }
+    });
+
+    return *result;
+  }
+
+  /**
+   * Atomically sets the value of atom using the given block. The current
+   * value is loaded, passed to the block, and the result is installed with a
+   * hardware compare-and-swap. If another thread changed the value in the
+   * meantime the loop retries with the freshly observed value.
+   *
+   * @note If the new value fails validation the attempt counts as failed and
+   *       the loop retries, exactly like the locking Atom.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename F>
+  T Swap(F&& func, int maxAttempts = 0)
+  {
+    return Swap(func, NoBackoff(), maxAttempts);
+  }
+
+  /**
+   * Works exactly like Swap() but calls the given backoff strategy after
+   * every failed attempt. See Backoff.h.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param backoff The strategy called with the number of attempts made so
+   *        far after every failed attempt.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename F, typename Backoff, typename = EnableIfBackoff<Backoff>>
+  T Swap(F&& func, Backoff backoff, int maxAttempts = 0)
+  {
+    T oldValue = Value();
+    int attempts{ 0 };
+
+    for (;;)
+    {
+      T newValue = func(oldValue);
+      attempts++;
+
+      if (trySwap(oldValue, newValue)
+          || (maxAttempts > 0 && attempts >= maxAttempts))
+      {
+        mStats.RecordSwap(attempts);
+        return newValue;
+      }
+
+      backoff(attempts);
+    }
+  }
+
+  /**
+   * Works like Swap() but gives up once the deadline has passed rather than
+   * after a number of attempts. At least one attempt is always made.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param deadline The point in time after which no further attempt is made.
+   * @param backoff The strategy called after every failed attempt.
+   *
+   * @return The new value if the update occurred, otherwise nothing.
+   */
+  template<typename F, typename Clock, typename Duration, typename Backoff = NoBackoff>
+  std::optional<T> SwapUntil(F&& func,
+                             const std::chrono::time_point<Clock, Duration>& deadline,
+                             Backoff backoff = Backoff())
+  {
+    T oldValue = Value();
+
+    for (int attempts = 1; ; attempts++)
+    {
+      T newValue = func(oldValue);
+
+      if (trySwap(oldValue, newValue))
+      {
+        mStats.RecordSwap(attempts);
+        return newValue;
+      }
+
+      if (Clock::now() >= deadline)
+      {
+        mStats.RecordSwap(attempts);
+        return std::nullopt;
+      }
+
+      backoff(attempts);
+    }
+  }
+
+  /**
+   * Works like SwapUntil() with a deadline relative to now.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param timeout How long to keep trying.
+   * @param backoff The strategy called after every failed attempt.
+   *
+   * @return The new value if the update occurred, otherwise nothing.
+   */
+  template<typename F, typename Rep, typename Period, typename Backoff = NoBackoff>
+  std::optional<T> SwapFor(F&& func,
+                           const std::chrono::duration<Rep, Period>& timeout,
+                           Backoff backoff = Backoff())
+  {
+    return SwapUntil(func, std::chrono::steady_clock::now() + timeout, backoff);
+  }
+
+  /**
+   * Calls the lambda with a snapshot of the current value.
+   *
+   * @param func The lambda used to operate with the current value.
+   */
+  template<typename F>
+  void With(F&& func)
+  {
+    const T currentValue = Value();
+    func(currentValue);
+  }
+
+  /**
+   * Calls the lambda with a mutable copy of the current value and installs
+   * the result with a compare-and-swap, retrying if the value changed in the
+   * meantime.
+   *
+   * @note Does not perform validation of the new value.
+   * @note The lambda may be called more than once.
+   *
+   * @param func The lambda used to modify the current value.
+   *
+   * @return The final value of the atom after all operations are complete.
+   */
+  template<typename F>
+  T Modify(F&& func)
+  {
+    std::optional<T> result;
+
+    write([&]() -> std::optional<T>
+    {
+      T oldValue = Value();
+
+      for (;;)
+      {
+        result = oldValue;
+        func(*result);
+
+        if (mValue.compare_exchange_weak(oldValue, *result,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire))
+        {
+          return oldValue;
+        }
+      }
+    });
+
+    return *result;
+  }
+
+  /**
+   * Atomically applies a range of update functions, in order, each one to
+   * the result of the previous one, and stores the result.
+   *
+   * @note Unlike the locking Atom the functions may be called more than once
+   *       and must be free of side effects.
+   *
+   * @param funcs The update functions, e.g. a `std::vector<UpdateFunc>`.
+   * @param validation Whether to validate only the final value or the result
+   *        of every function. See BatchValidation.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename Range>
+  T ResetBatch(const Range& funcs, BatchValidation validation = BatchValidation::Once)
+  {
+    return Reset([&](const T& currentValue)
+                 {
+                   return ApplyUpdateBatch(funcs, currentValue, validation,
+                                           [this](const T& value){ return isValid(value); });
+                 });
+  }
+
+  /**
+   * Works like ResetBatch() but takes the functions as an initializer list.
+   */
+  T ResetBatch(std::initializer_list<UpdateFunc> funcs,
+               BatchValidation validation = BatchValidation::Once)
+  {
+    return ResetBatch<std::initializer_list<UpdateFunc>>(funcs, validation);
+  }
+
+  /**
+   * Works like ResetBatch() but with the retry behaviour of Swap().
+   *
+   * @param funcs The update functions, e.g. a `std::vector<UpdateFunc>`.
+   * @param validation Whether to validate only the final value or the result
+   *        of every function. See BatchValidation.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current value after the update has occurred (or been rejected
+   *         as invalid).
+   */
+  template<typename Range>
+  T SwapBatch(const Range& funcs,
+              BatchValidation validation = BatchValidation::Once,
+              int maxAttempts = 0)
+  {
+    return Swap([&](const T& currentValue)
+                {
+                  return ApplyUpdateBatch(funcs, currentValue, validation,
+                                          [this](const T& value){ return isValid(value); });
+                }, maxAttempts);
+  }
+
+  /**
+   * Works like SwapBatch() but takes the functions as an initializer list.
+   */
+  T SwapBatch(std::initializer_list<UpdateFunc> funcs,
+              BatchValidation validation = BatchValidation::Once,
+              int maxAttempts = 0)
+  {
+    return SwapBatch<std::initializer_list<UpdateFunc>>(funcs, validation, maxAttempts);
+  }
+
+  /**
+   * Blocks the calling thread until the value satisfies the predicate. The
+   * thread is parked rather than polling and is only woken by writes.
+   *
+   * @note The lock-free atom keeps no version, so there is no WaitChange().
+   *
+   * @param pred Called with the current value after every write until it
+   *        returns `true`.
+   *
+   * @return The first value observed which satisfied the predicate.
+   */
+  template<typename F>
+  T WaitUntil(F&& pred)
+  {
+    return *waitUntil(pred, std::optional<ParkingLot::Clock::time_point>());
+  }
+
+  /**
+   * Works like WaitUntil() but gives up after the timeout.
+   *
+   * @param pred Called with the current value after every write until it
+   *        returns `true`.
+   * @param timeout How long to wait.
+   *
+   * @return The first value observed which satisfied the predicate, or
+   *         nothing if the timeout passed first.
+   */
+  template<typename F, typename Rep, typename Period>
+  std::optional<T> WaitFor(F&& pred, const std::chrono::duration<Rep, Period>& timeout)
+  {
+    auto deadline = ParkingLot::Clock::now()
+                  + std::chrono::duration_cast<ParkingLot::Clock::duration>(timeout);
+
+    return waitUntil(pred, std::optional<ParkingLot::Clock::time_point>(deadline));
+  }
+
+  /**
+   * Adds a watcher which is called with the old and new value after every
+   * successful write. Adding a watcher with the key of an existing watcher
+   * replaces it.
+   *
+   * Watchers are called once the write is complete, so a watcher may use
+   * the atom. With WatchMode::Coalesce a watcher is never called
+   * concurrently with itself and always sees the newest value last.
+   *
+   * An exception thrown by a watcher is caught and dropped. It neither
+   * fails the write nor escapes into the executor's thread.
+   *
+   * @note While an atom is watched its writes take turns on a lock, so every
+   *       change is reported with its place in the order of changes. Reads
+   *       stay lock-free.
+   *
+   * @param key Identifies the watcher, e.g. for RemoveWatch().
+   * @param func Called as `func(oldValue, newValue)`.
+   * @param executor Where the watcher is called. By default it is called
+   *        inline by the thread which wrote the value.
+   * @param mode Whether changes made while the watcher is busy are merged.
+   */
+  void AddWatch(const std::string& key,
+                WatchFunc func,
+                Executor& executor = InlineExecutor::Instance(),
+                WatchMode mode = WatchMode::EveryChange)
+  {
+    mWatches.Add(key, std::move(func), executor, mode);
+  }
+
+  /**
+   * Removes the watcher with the given key. A call which is already running
+   * or which has been handed to an executor may still complete.
+   *
+   * @param key Identifies the watcher.
+   *
+   * @return `true` if there was such a watcher else `false`.
+   */
+  bool RemoveWatch(const std::string& key)
+  {
+    return mWatches.Remove(key);
+  }
+
+  /**
+   * Obtain what the atom has recorded about its use so far. Always empty
+   * unless the atom was declared with a recording StatsPolicy such as
+   * AtomStats.
+   *
+   * @return A snapshot of the statistics.
+   */
+  AtomStatistics Statistics() const
+  {
+    return mStats.Snapshot();
+  }
+
+  /**
+   * Sets every recorded statistic back to zero, e.g. after scraping them.
+   */
+  void ClearStatistics()
+  {
+    mStats.Clear();
+  }
+
+protected:
+
+  /**
+   * Validates the new value against the validator function.
    *
    * @param newValue The value to be validated.
    *
@@ -387,18 +2008,162 @@ protected:
    */
   bool isValid(const T& newValue)
   {
-    return mValidator(newValue);
+    if (InvokeValidator(mValidator, newValue))
+    {
+      return true;
+    }
+
+    mStats.RecordValidationFailure();
+    return false;
   }
 
 private:
 
-  T mValue;
+  /**
+   * Makes a single Swap() attempt. On failure `oldValue` holds the value
+   * to base the next attempt on.
+   */
+  bool trySwap(T& oldValue, const T& newValue)
+  {
+    if (!isValid(newValue))
+    {
+      oldValue = Value();
+      return false;
+    }
+
+    return write([&]() -> std::optional<T>
+    {
+      if (!mValue.compare_exchange_weak(oldValue, newValue,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire))
+      {
+        return std::nullopt;
+      }
+
+      return oldValue;
+    }).has_value();
+  }
+
+  /**
+   * Makes a write and wakes waiters. The function makes the write with
+   * atomic operations and returns the value it replaced, or nothing if it
+   * changed nothing.
+   */
+  template<typename F>
+  std::optional<T> write(F&& func)
+  {
+    if (!mWatches.Empty())
+    {
+      return watchedWrite(func);
+    }
+
+    std::optional<T> oldValue = func();
+
+    if (oldValue)
+    {
+      notifyWaiters();
+    }
+
+    return oldValue;
+  }
+
+  /**
+   * Works like write() but also tells the watchers. Writes to a watched atom
+   * take turns on a lock so they are numbered, and reported, in the order
+   * they were made.
+   */
+  template<typename F>
+  std::optional<T> watchedWrite(F& func)
+  {
+    std::optional<T> oldValue;
+    std::optional<T> newValue;
+    uint64_t version{ 0 };
+
+    {
+      std::lock_guard<AdaptiveMutex> lock(mWatchedWrites);
+      oldValue = func();
+
+      if (!oldValue)
+      {
+        return std::nullopt;
+      }
+
+      newValue = mValue.load(std::memory_order_relaxed);
+      version = ++mWatchVersion;
+    }
+
+    notifyWaiters();
+    mWatches.Notify(*oldValue, *newValue, version);
+
+    return oldValue;
+  }
+
+  /**
+   * The implementation of WaitUntil() and WaitFor(). There is no version to
+   * wait on, so a parked thread waits for the bytes of the value to change.
+   */
+  template<typename F>
+  std::optional<T> waitUntil(F& pred, std::optional<ParkingLot::Clock::time_point> deadline)
+  {
+    for (;;)
+    {
+      T observed = Value();
+
+      if (pred(static_cast<const T&>(observed)))
+      {
+        return observed;
+      }
+
+      mWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+      auto unchanged = [&]()
+      {
+        T current = mValue.load(std::memory_order_seq_cst);
+        return std::memcmp(&current, &observed, sizeof(T)) == 0;
+      };
+
+      bool changed = deadline ? ParkingLot::ParkUntil(this, unchanged, *deadline)
+                              : ParkingLot::Park(this, unchanged);
+
+      mWaiters.fetch_sub(1, std::memory_order_relaxed);
+
+      if (!changed)
+      {
+        return std::nullopt;
+      }
+    }
+  }
+
+  /**
+   * Wakes parked threads after a successful write. The fence orders the
+   * write before the check of the waiter count, pairing with the waiter
+   * which registers before checking the value.
+   */
+  void notifyWaiters()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (mWaiters.load(std::memory_order_relaxed) != 0)
+    {
+      ParkingLot::UnparkAll(this);
+    }
+  }
+
+  std::atomic<T> mValue;
+
+  std::atomic<uint32_t> mWaiters{ 0 };
+
+  AdaptiveMutex mWatchedWrites;
+
+  /**
+   * Numbers the changes reported to watchers in the order they were made.
+   * Only written while mWatchedWrites is held.
+   */
+  uint64_t mWatchVersion{ 0 };
+
+  Watches<T> mWatches;
 
-  ValidateFunc mValidator;
+  Validator mValidator;
 
-#ifdef CPP17
-  mutable std::shared_mutex mMutex;
-#else
-  std::mutex mMutex;
-#endif
+  StatsPolicy mStats;
 };
@@ -0,0 +1,467 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Atom.h>
+#include <LockPolicy.h>
+
+/**
+ * Layout of an AtomVector in which every element gets a cache line (or
+ * more) of its own, holding its lock, its version, and its value. Writes to
+ * different elements never contend, not even on the cache line. The price
+ * is memory: at least CacheLineSize bytes per element.
+ */
+struct PaddedLayout
+{
+  template<typename T, typename Mutex>
+  class Storage
+  {
+  public:
+
+    Storage(size_t size, const T& initialValue)
+      : mSize(size)
+      , mCells(new Cell[size])
+      {
+        for (size_t i = 0; i < size; i++)
+        {
+          mCells[i].value = initialValue;
+        }
+      }
+
+    size_t Size() const
+    {
+      return mSize;
+    }
+
+    T& ValueAt(size_t index)
+    {
+      return mCells[index].value;
+    }
+
+    size_t LockCount() const
+    {
+      return mSize;
+    }
+
+    size_t LockIndexFor(size_t index) const
+    {
+      return index;
+    }
+
+    Mutex& LockAt(size_t lock)
+    {
+      return mCells[lock].mutex;
+    }
+
+    uint64_t& VersionAt(size_t lock)
+    {
+      return mCells[lock].version;
+    }
+
+  private:
+
+    struct alignas(CacheLineSize) Cell
+    {
+      Mutex mutex;
+      uint64_t version{ 0 };
+      T value;
+    };
+
+    size_t mSize;
+
+    std::unique_ptr<Cell[]> mCells;
+  };
+};
+
+/**
+ * Layout of an AtomVector in which the values are stored contiguously and
+ * protected by a fixed number of lock stripes, each on its own cache line. Element `i` is protected by stripe `i % Stripes`,
+ * so neighbouring elements use different locks. Memory overhead is
+ * independent of the number of elements, but neighbouring values still
+ * share cache lines, so writes to neighbours are not entirely free of false
+ * sharing.
+ *
+ * @tparam Stripes The number of lock stripes.
+ */
+template<size_t Stripes = 16>
+struct StripedLayout
+{
+  static_assert(Stripes > 0, "StripedLayout requires at least one stripe");
+
+  template<typename T, typename Mutex>
+  class Storage
+  {
+  public:
+
+    Storage(size_t size, const T& initialValue)
+      : mSize(size)
+      , mValues(new T[size])
+      , mStripes(new Stripe[Stripes])
+      {
+        std::fill(mValues.get(), mValues.get() + size, initialValue);
+      }
+
+    size_t Size() const
+    {
+      return mSize;
+    }
+
+    T& ValueAt(size_t index)
+    {
+      return mValues[index];
+    }
+
+    size_t LockCount() const
+    {
+      return std::min(Stripes, mSize);
+    }
+
+    size_t LockIndexFor(size_t index) const
+    {
+      return index % Stripes;
+    }
+
+    Mutex& LockAt(size_t lock)
+    {
+      return mStripes[lock].mutex;
+    }
+
+    uint64_t& VersionAt(size_t lock)
+    {
+      return mStripes[lock].version;
+    }
+
+  private:
+
+    struct alignas(CacheLineSize) Stripe
+    {
+      Mutex mutex;
+      uint64_t version{ 0 };
+    };
+
+    size_t mSize;
+
+    // not a std::vector, whose bool specialization packs neighbours into one word
+    std::unique_ptr<T[]> mValues;
+
+    std::unique_ptr<Stripe[]> mStripes;
+  };
+};
+
+/**
+ * A fixed-size sequence of independently updated atomic values, for example
+ * one per shard.
+ *
+ * A `std::vector<Atom<T>>` pays for a mutex and a `std::function` validator
+ * per element and lets neighbouring atoms share cache lines, so threads
+ * writing to different atoms still stall each other. An AtomVector instead
+ * lays the elements out according to the Layout: PaddedLayout gives every
+ * element a cache line of its own, StripedLayout stores the values
+ * compactly behind a fixed set of lock stripes. Either way the lock is a
+ * small Mutex (a one byte SpinMutex by default) and there are no per-element
+ * validators.
+ *
+ * Every element behaves like an Atom: Value(), Reset(), Swap(), Modify(),
+ * CompareAndSet(), and With() take the index of the element first. Swap()
+ * checks the version of the element's lock rather than comparing values.
+ * With StripedLayout the version is shared by the whole stripe, so a write
+ * to another element of the same stripe makes Swap() retry needlessly but
+ * never incorrectly.
+ *
+ * Snapshot() copies every element at a single point in time. ForEach() is
+ * cheaper but visits each element at a different point in time.
+ *
+ * @tparam T The type of the values. Must be default constructible.
+ * @tparam Layout PaddedLayout or StripedLayout.
+ * @tparam Mutex Any type satisfying the standard Lockable requirements.
+ *
+ * @see Atom
+ */
+template<typename T,
+         typename Layout = PaddedLayout,
+         typename Mutex = SpinMutex>
+class AtomVector
+{
+public:
+
+  /**
+   * Constructs the given number of elements, each holding the initial
+   * value.
+   *
+   * @param size The number of elements.
+   * @param initialValue The initial value of every element.
+   */
+  explicit AtomVector(size_t size, const T& initialValue = T())
+    : mStorage(size, initialValue)
+    {
+    }
+
+  AtomVector(const AtomVector&) = delete;
+  AtomVector& operator = (const AtomVector&) = delete;
+
+  virtual ~AtomVector() {  }
+
+  /**
+   * @return The number of elements.
+   */
+  size_t Size() const
+  {
+    return mStorage.Size();
+  }
+
+  /**
+   * Atomically obtain a copy of the element's value.
+   *
+   * @param index The index of the element.
+   *
+   * @return The current value.
+   */
+  T Value(size_t index)
+  {
+    return locked(index, [&](T& value, uint64_t&){ return value; });
+  }
+
+  /**
+   * Atomically overwrite the element's value.
+   *
+   * @param index The index of the element.
+   * @param newValue The intended new value.
+   *
+   * @return The new value.
+   */
+  T Reset(size_t index, const T& newValue)
+  {
+    return locked(index, [&](T& value, uint64_t& version)
+    {
+      value = newValue;
+      version++;
+      return value;
+    });
+  }
+
+  /**
+   * Atomically sets the element's value using the given block, holding the
+   * element's lock while the block runs. The block runs exactly once.
+   *
+   * @param index The index of the element.
+   * @param func The lambda used to calculate the new value.
+   *
+   * @return The new value.
+   */
+  template<typename F, typename = EnableIfUpdateFunc<F, T>>
+  T Reset(size_t index, F&& func)
+  {
+    return locked(index, [&](T& value, uint64_t& version)
+    {
+      value = func(static_cast<const T&>(value));
+      version++;
+      return value;
+    });
+  }
+
+  /**
+   * Atomically sets the element's value using the given block without
+   * holding the lock while the block runs. The block may run more than
+   * once and must be free of side effects. See Atom::Swap().
+   *
+   * @param index The index of the element.
+   * @param func The lambda used to calculate the new value.
+   *
+   * @return The new value.
+   */
+  template<typename F>
+  T Swap(size_t index, F&& func)
+  {
+    for (;;)
+    {
+      std::pair<T, uint64_t> current = locked(index, [](T& value, uint64_t& version)
+      {
+        return std::pair<T, uint64_t>(value, version);
+      });
+
+      T newValue = func(static_cast<const T&>(current.first));
+
+      bool swapped = locked(index, [&](T& value, uint64_t& version)
+      {
+        if (version != current.second)
+        {
+          return false;
+        }
+
+        value = newValue;
+        version++;
+        return true;
+      });
+
+      if (swapped)
+      {
+        return newValue;
+      }
+    }
+  }
+
+  /**
+   * Atomically sets the element's value to the new value if and only if
+   * the current value is equal to the old value.
+   *
+   * @param index The index of the element.
+   * @param oldValue The expected current value.
+   * @param newValue The intended new value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  bool CompareAndSet(size_t index, const T& oldValue, const T& newValue)
+  {
+    return locked(index, [&](T& value, uint64_t& version)
+    {
+      if (!(value == oldValue))
+      {
+        return false;
+      }
+
+      value = newValue;
+      version++;
+      return true;
+    });
+  }
+
+  /**
+   * Atomically calls the lambda with the element's value.
+   *
+   * @param index The index of the element.
+   * @param func The lambda used to operate with the current value.
+   */
+  template<typename F>
+  void With(size_t index, F&& func)
+  {
+    locked(index, [&](T& value, uint64_t&){ func(static_cast<const T&>(value)); });
+  }
+
+  /**
+   * Atomically calls the lambda with a mutable reference to the element's
+   * value.
+   *
+   * @param index The index of the element.
+   * @param func The lambda used to modify the current value.
+   *
+   * @return The new value.
+   */
+  template<typename F>
+  T Modify(size_t index, F&& func)
+  {
+    return locked(index, [&](T& value, uint64_t& version)
+    {
+      func(value);
+      version++;
+      return value;
+    });
+  }
+
+  /**
+   * Calls the lambda with the index and value of every element, in order,
+   * holding only the lock of the element being visited. Cheaper than
+   * Snapshot() and never blocks writers for long, but elements are visited
+   * at different points in time.
+   *
+   * @param func Called as `func(index, value)`.
+   */
+  template<typename F>
+  void ForEach(F&& func)
+  {
+    for (size_t i = 0; i < Size(); i++)
+    {
+      locked(i, [&](T& value, uint64_t&){ func(i, static_cast<const T&>(value)); });
+    }
+  }
+
+  /**
+   * Atomically copies every element. All locks are held while copying, so
+   * the result reflects a single point in time.
+   *
+   * @return The values of all elements, in order.
+   */
+  std::vector<T> Snapshot()
+  {
+    const size_t locks = mStorage.LockCount();
+
+    // always in the same order, so concurrent snapshots cannot deadlock
+    for (size_t i = 0; i < locks; i++)
+    {
+      mStorage.LockAt(i).lock();
+    }
+
+    std::vector<T> values;
+    values.reserve(Size());
+
+    try
+    {
+      for (size_t i = 0; i < Size(); i++)
+      {
+        values.push_back(mStorage.ValueAt(i));
+      }
+    }
+    catch (...)
+    {
+      unlockAll(locks);
+      throw;
+    }
+
+    unlockAll(locks);
+    return values;
+  }
+
+private:
+
+  template<typename F>
+  auto locked(size_t index, F&& func)
+    -> decltype(func(std::declval<T&>(), std::declval<uint64_t&>()))
+  {
+    size_t lock = mStorage.LockIndexFor(index);
+    std::lock_guard<Mutex> guard(mStorage.LockAt(lock));
+    return func(mStorage.ValueAt(index), mStorage.VersionAt(lock));
+  }
+
+  void unlockAll(size_t locks)
+  {
+    for (size_t i = locks; i > 0; i--)
+    {
+      mStorage.LockAt(i - 1).unlock();
+    }
+  }
+
+  typename Layout::template Storage<T, Mutex> mStorage;
+};
+
+/**
+ * An AtomVector whose number of elements is part of its type.
+ *
+ * @tparam T The type of the values.
+ * @tparam N The number of elements.
+ * @tparam Layout PaddedLayout or StripedLayout.
+ * @tparam Mutex Any type satisfying the standard Lockable requirements.
+ */
+template<typename T,
+         size_t N,
+         typename Layout = PaddedLayout,
+         typename Mutex = SpinMutex>
+class AtomArray : public AtomVector<T, Layout, Mutex>
+{
+public:
+
+  /**
+   * Constructs N elements, each holding the initial value.
+   *
+   * @param initialValue The initial value of every element.
+   */
+  explicit AtomArray(const T& initialValue = T())
+    : AtomVector<T, Layout, Mutex>(N, initialValue)
+    {
+    }
+};
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Statistics policies decide what an Atom records about how it is used.
+ *
+ * The statistics policy is the fourth template parameter of Atom. Every
+ * access to the lock policy goes through the statistics policy, and Atom
+ * reports validation failures, value copies, and the number of attempts
+ * every Swap() needed to it. Two policies are shipped:
+ *
+ *  - NoStats: records nothing. Every hook is an empty inline function, so an
+ *    Atom without statistics compiles to exactly the same code as before.
+ *    The default.
+ *  - AtomStats: counts lock acquisitions, validation failures, copies and
+ *    Swap() retries, and keeps histograms of how long threads waited for the
+ *    lock and how long they held it.
+ *
+ * Counters are updated with relaxed atomic increments. Timing a lock
+ * acquisition costs two reads of the steady clock, so AtomStats is cheap
+ * enough to leave enabled on a few suspect atoms in production, but not
+ * free. Use it to find the hot atoms, not on all of them.
+ *
+ * @code
+ * Atom<Config, ExclusiveLock, Atom<Config>::ValidateFunc, AtomStats> config(initial);
+ * ...
+ * AtomStatistics stats = config.Statistics();
+ * std::cout << stats.waitTime.Percentile(0.99) << "ns p99 wait\n";
+ * @endcode
+ */
+
+/**
+ * A snapshot of a Histogram.
+ */
+struct HistogramSnapshot
+{
+  /**
+   * The number of buckets. Bucket `i` counts samples in [2^(i-1), 2^i),
+   * bucket zero counts samples of zero.
+   */
+  static constexpr size_t Buckets = 64;
+
+  std::array<uint64_t, Buckets> counts{};
+
+  /**
+   * @return The total number of samples.
+   */
+  uint64_t Count() const
+  {
+    uint64_t count{ 0 };
+
+    for (uint64_t bucket : counts)
+    {
+      count += bucket;
+    }
+
+    return count;
+  }
+
+  /**
+   * Estimate a percentile.
+   *
+   * @param fraction The percentile as a fraction, e.g. `0.99` for p99.
+   *
+   * @return The upper bound of the bucket holding the percentile, so the
+   *         estimate is at most twice the real value. Zero if there are no
+   *         samples.
+   */
+  uint64_t Percentile(double fraction) const
+  {
+    uint64_t count = Count();
+
+    if (count == 0)
+    {
+      return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(fraction * (count - 1)) + 1;
+    uint64_t seen{ 0 };
+
+    for (size_t i = 0; i < Buckets; i++)
+    {
+      seen += counts[i];
+
+      if (seen >= rank)
+      {
+        return UpperBound(i);
+      }
+    }
+
+    return UpperBound(Buckets - 1);
+  }
+
+  /**
+   * @return The largest sample which falls into the given bucket.
+   */
+  static uint64_t UpperBound(size_t bucket)
+  {
+    return (uint64_t(1) << bucket) - 1;
+  }
+};
+
+/**
+ * A histogram with power of two buckets which can be recorded into from
+ * many threads at once.
+ */
+class Histogram
+{
+public:
+
+  /**
+   * Records one sample.
+   *
+   * @param sample The sample.
+   */
+  void Record(uint64_t sample)
+  {
+    mCounts[bucketFor(sample)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return A copy of the current bucket counts.
+   */
+  HistogramSnapshot Snapshot() const
+  {
+    HistogramSnapshot snapshot;
+
+    for (size_t i = 0; i < HistogramSnapshot::Buckets; i++)
+    {
+      snapshot.counts[i] = mCounts[i].load(std::memory_order_relaxed);
+    }
+
+    return snapshot;
+  }
+
+  /**
+   * Clears every bucket.
+   */
+  void Clear()
+  {
+    for (std::atomic<uint64_t>& count : mCounts)
+    {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+
+  static size_t bucketFor(uint64_t sample)
+  {
+    size_t bucket{ 0 };
+
+    while (sample != 0 && bucket < HistogramSnapshot::Buckets - 1)
+    {
+      sample >>= 1;
+      bucket++;
+    }
+
+    return bucket;
+  }
+
+  std::array<std::atomic<uint64_t>, HistogramSnapshot::Buckets> mCounts{};
+};
+
+/**
+ * What an Atom recorded about how it was used. Times are in nanoseconds.
+ */
+struct AtomStatistics
+{
+  /**
+   * The number of times the lock was taken to read.
+   */
+  uint64_t reads{ 0 };
+
+  /**
+   * The number of times the lock was taken to write.
+   */
+  uint64_t writes{ 0 };
+
+  /**
+   * How long threads waited for the lock.
+   */
+  HistogramSnapshot waitTime;
+
+  /**
+   * How long threads held the lock.
+   */
+  HistogramSnapshot holdTime;
+
+  /**
+   * The number of Swap() calls.
+   */
+  uint64_t swaps{ 0 };
+
+  /**
+   * The number of failed Swap() attempts, summed over all calls.
+   */
+  uint64_t swapRetries{ 0 };
+
+  /**
+   * The number of attempts each Swap() call needed.
+   */
+  HistogramSnapshot swapAttempts;
+
+  /**
+   * The number of new values rejected by the validator.
+   */
+  uint64_t validationFailures{ 0 };
+
+  /**
+   * The number of times the value was copied out of the atom.
+   */
+  uint64_t copies{ 0 };
+};
+
+/**
+ * Statistics policy which records nothing.
+ */
+struct NoStats
+{
+  template<typename Lock, typename V, typename F>
+  auto Read(Lock& lock, const V& value, F&& func) -> decltype(func(value))
+  {
+    return lock.Read(value, func);
+  }
+
+  template<typename Lock, typename V, typename F>
+  auto Write(Lock& lock, V& value, F&& func) -> decltype(func(value))
+  {
+    return lock.Write(value, func);
+  }
+
+  void RecordSwap(int)
+  {
+  }
+
+  void RecordValidationFailure()
+  {
+  }
+
+  void RecordCopy()
+  {
+  }
+
+  AtomStatistics Snapshot() const
+  {
+    return AtomStatistics();
+  }
+
+  void Clear()
+  {
+  }
+};
+
+/**
+ * Statistics policy which records lock wait and hold times, Swap() retries,
+ * validation failures, and copies.
+ *
+ * The wait time is measured from the moment the atom asks its lock policy
+ * for access until the critical section starts, the hold time from there
+ * until the critical section ends. For SeqLock reads the wait includes the
+ * retries, for FlatCombining writes it includes the time spent waiting for
+ * the combiner.
+ */
+class AtomStats
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  template<typename Lock, typename V, typename F>
+  auto Read(Lock& lock, const V& value, F&& func) -> decltype(func(value))
+  {
+    mReads.fetch_add(1, std::memory_order_relaxed);
+
+    Clock::time_point requested = Clock::now();
+
+    return lock.Read(value, [&](const V& current) -> decltype(func(value))
+    {
+      Timer timer(*this, requested);
+      return func(current);
+    });
+  }
+
+  template<typename Lock, typename V, typename F>
+  auto Write(Lock& lock, V& value, F&& func) -> decltype(func(value))
+  {
+    mWrites.fetch_add(1, std::memory_order_relaxed);
+
+    Clock::time_point requested = Clock::now();
+
+    return lock.Write(value, [&](V& current) -> decltype(func(value))
+    {
+      Timer timer(*this, requested);
+      return func(current);
+    });
+  }
+
+  /**
+   * Records a Swap() call which needed the given number of attempts.
+   */
+  void RecordSwap(int attempts)
+  {
+    mSwaps.fetch_add(1, std::memory_order_relaxed);
+    mSwapRetries.fetch_add(static_cast<uint64_t>(attempts - 1), std::memory_order_relaxed);
+    mSwapAttempts.Record(static_cast<uint64_t>(attempts));
+  }
+
+  void RecordValidationFailure()
+  {
+    mValidationFailures.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RecordCopy()
+  {
+    mCopies.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @return A copy of everything recorded so far. Taken without stopping
+   *         concurrent updates, so the counters may be slightly out of step
+   *         with each other.
+   */
+  AtomStatistics Snapshot() const
+  {
+    AtomStatistics snapshot;
+
+    snapshot.reads = mReads.load(std::memory_order_relaxed);
+    snapshot.writes = mWrites.load(std::memory_order_relaxed);
+    snapshot.waitTime = mWaitTime.Snapshot();
+    snapshot.holdTime = mHoldTime.Snapshot();
+    snapshot.swaps = mSwaps.load(std::memory_order_relaxed);
+    snapshot.swapRetries = mSwapRetries.load(std::memory_order_relaxed);
+    snapshot.swapAttempts = mSwapAttempts.Snapshot();
+    snapshot.validationFailures = mValidationFailures.load(std::memory_order_relaxed);
+    snapshot.copies = mCopies.load(std::memory_order_relaxed);
+
+    return snapshot;
+  }
+
+  /**
+   * Sets every counter back to zero.
+   */
+  void Clear()
+  {
+    mReads.store(0, std::memory_order_relaxed);
+    mWrites.store(0, std::memory_order_relaxed);
+    mWaitTime.Clear();
+    mHoldTime.Clear();
+    mSwaps.store(0, std::memory_order_relaxed);
+    mSwapRetries.store(0, std::memory_order_relaxed);
+    mSwapAttempts.Clear();
+    mValidationFailures.store(0, std::memory_order_relaxed);
+    mCopies.store(0, std::memory_order_relaxed);
+  }
+
+private:
+
+  /**
+   * Records the wait time when the critical section starts and the hold
+   * time when it ends, even if it ends with an exception.
+   */
+  class Timer
+  {
+  public:
+
+    Timer(AtomStats& stats, Clock::time_point requested)
+      : mStats(stats)
+      , mAcquired(Clock::now())
+      {
+        mStats.mWaitTime.Record(nanoseconds(mAcquired - requested));
+      }
+
+    ~Timer()
+    {
+      mStats.mHoldTime.Record(nanoseconds(Clock::now() - mAcquired));
+    }
+
+  private:
+
+    AtomStats& mStats;
+    Clock::time_point mAcquired;
+  };
+
+  static uint64_t nanoseconds(Clock::duration duration)
+  {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+  }
+
+  std::atomic<uint64_t> mReads{ 0 };
+  std::atomic<uint64_t> mWrites{ 0 };
+
+  Histogram mWaitTime;
+  Histogram mHoldTime;
+
+  std::atomic<uint64_t> mSwaps{ 0 };
+  std::atomic<uint64_t> mSwapRetries{ 0 };
+  Histogram mSwapAttempts;
+
+  std::atomic<uint64_t> mValidationFailures{ 0 };
+  std::atomic<uint64_t> mCopies{ 0 };
+};
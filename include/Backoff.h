@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <type_traits>
+
+#include <LockPolicy.h>
+
+/**
+ * Backoff strategies decide what a thread does between two failed attempts
+ * of an optimistic retry loop such as Atom::Swap().
+ *
+ * A backoff strategy is any callable taking the number of attempts made so
+ * far (starting at one). A fresh copy of the strategy is used for every
+ * call to Swap(), so strategies may keep per-call state. Under heavy
+ * contention backing off keeps the retrying threads from hammering the lock
+ * or cache line all the others are trying to use, so throughput stays flat
+ * instead of collapsing.
+ *
+ *  - NoBackoff: retry immediately. The default.
+ *  - PauseBackoff: spin on the processor's pause instruction, doubling the
+ *    spin count every attempt.
+ *  - YieldBackoff: give the rest of the time slice to another thread.
+ *  - ExponentialBackoff: spin for a random number of pauses drawn from an
+ *    exponentially growing window (exponential backoff with full jitter).
+ *  - ParkingBackoff: back off exponentially for a number of attempts, then
+ *    put the thread to sleep.
+ */
+
+/**
+ * Determines whether `B` can be used as a backoff strategy.
+ */
+template<typename B>
+struct IsBackoff : std::is_invocable<B&, int>
+{
+};
+
+/**
+ * Retries immediately.
+ */
+struct NoBackoff
+{
+  void operator () (int)
+  {
+  }
+};
+
+/**
+ * Spins on the processor's pause instruction. The number of pauses starts
+ * at one and doubles every attempt up to the given limit.
+ */
+class PauseBackoff
+{
+public:
+
+  explicit PauseBackoff(int maxSpins = 1024)
+    : mMaxSpins(maxSpins)
+    {
+    }
+
+  void operator () (int)
+  {
+    for (int i = 0; i < mSpins; i++)
+    {
+      CpuRelax();
+    }
+
+    if (mSpins < mMaxSpins)
+    {
+      mSpins *= 2;
+    }
+  }
+
+private:
+
+  int mSpins{ 1 };
+  int mMaxSpins;
+};
+
+/**
+ * Yields the rest of the time slice on every failed attempt.
+ */
+struct YieldBackoff
+{
+  void operator () (int)
+  {
+    std::this_thread::yield();
+  }
+};
+
+/**
+ * Spins for a random number of pauses between zero and a window which starts
+ * at `minSpins` (at least one) and doubles every attempt up to `maxSpins`.
+ * The jitter keeps threads which failed together from retrying together.
+ *
+ * The random numbers come from a generator per thread rather than per
+ * strategy, so copies of one strategy used by different threads still draw
+ * different numbers.
+ */
+class ExponentialBackoff
+{
+public:
+
+  explicit ExponentialBackoff(uint32_t minSpins = 4, uint32_t maxSpins = 4096)
+    : mWindow(std::max<uint32_t>(minSpins, 1))
+    , mMaxSpins(maxSpins)
+    {
+    }
+
+  void operator () (int)
+  {
+    uint32_t spins = next() % (mWindow + 1);
+
+    for (uint32_t i = 0; i < spins; i++)
+    {
+      CpuRelax();
+    }
+
+    if (mWindow < mMaxSpins)
+    {
+      mWindow *= 2;
+    }
+  }
+
+private:
+
+  /**
+   * A xorshift generator, seeded from the calling thread's id. Cheap, and
+   * random enough for jitter.
+   */
+  static uint32_t next()
+  {
+    thread_local uint32_t seed =
+      static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  }
+
+  uint32_t mWindow;
+  uint32_t mMaxSpins;
+};
+
+/**
+ * Backs off exponentially for the first `spinAttempts` attempts and puts the
+ * thread to sleep for `parkDuration` on every attempt after that, so a
+ * thread which keeps losing stops consuming a core altogether.
+ */
+class ParkingBackoff
+{
+public:
+
+  explicit ParkingBackoff(int spinAttempts = 16,
+                          std::chrono::microseconds parkDuration = std::chrono::microseconds(50))
+    : mSpinAttempts(spinAttempts)
+    , mParkDuration(parkDuration)
+    {
+    }
+
+  void operator () (int attempt)
+  {
+    if (attempt <= mSpinAttempts)
+    {
+      mSpin(attempt);
+    }
+    else
+    {
+      std::this_thread::sleep_for(mParkDuration);
+    }
+  }
+
+private:
+
+  ExponentialBackoff mSpin;
+  int mSpinAttempts;
+  std::chrono::microseconds mParkDuration;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include <Atom.h>
+
+/**
+ * A CachedReader keeps a private copy of the value of an Atom and refreshes
+ * it only when the atom has been written since, for values which are read
+ * far more often than they change, such as configuration.
+ *
+ * Atom::Value() takes the lock and copies the value on every call. The
+ * CachedReader instead compares the version of its copy with the atom's
+ * epoch, a single atomic load which never touches the lock. Only when the
+ * two differ does it take the lock and copy the value again. Readers of an
+ * unchanged value therefore neither contend with each other nor copy.
+ *
+ * A CachedReader is not thread safe. Give every thread its own, for
+ * example:
+ *
+ * @code
+ * thread_local CachedReader<Config> config(globalConfig);
+ * const Config& current = config.Value();
+ * @endcode
+ *
+ * @note The reader holds a reference to the atom, which must outlive it.
+ *
+ * @see Atom::Epoch()
+ */
+template<typename T,
+         typename LockPolicy = DefaultLockPolicy<T>,
+         typename Validator = std::function<bool(const T&)>,
+         typename StatsPolicy = NoStats>
+class CachedReader
+{
+  static_assert(!std::is_same<LockPolicy, LockFree>::value,
+                "A LockFree Atom is read with a single load and needs no cache");
+
+public:
+
+  typedef Atom<T, LockPolicy, Validator, StatsPolicy> AtomType;
+
+  /**
+   * Constructs a reader for the given atom, copying its current value.
+   *
+   * @param atom The atom to read.
+   */
+  explicit CachedReader(AtomType& atom)
+    : mAtom(atom)
+    , mCache(atom.ValueWithVersion())
+    {
+    }
+
+  /**
+   * Obtain the current value, refreshing the cached copy first if the atom
+   * has been written since it was taken.
+   *
+   * @return The cached copy, valid until the next call on this reader.
+   */
+  const T& Value()
+  {
+    if (mAtom.Epoch() != mCache.second)
+    {
+      Refresh();
+    }
+
+    return mCache.first;
+  }
+
+  /**
+   * Unconditionally copy the current value of the atom.
+   */
+  void Refresh()
+  {
+    mCache = mAtom.ValueWithVersion();
+  }
+
+  /**
+   * @return `true` if the atom has been written since the cached copy was
+   *         taken else `false`.
+   */
+  bool Stale() const
+  {
+    return mAtom.Epoch() != mCache.second;
+  }
+
+  /**
+   * @return The version of the cached copy.
+   */
+  uint64_t Version() const
+  {
+    return mCache.second;
+  }
+
+private:
+
+  AtomType& mAtom;
+
+  std::pair<T, uint64_t> mCache;
+};
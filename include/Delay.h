@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include <ParkingLot.h>
+
+/**
+ * A value which is computed the first time it is needed and never again.
+ *
+ * The first call to Value() runs the function and stores its result. Threads
+ * calling Value() while the function runs are parked until it is done;
+ * every later call returns the stored value after a single acquire load,
+ * without locking or writing to shared memory. If the function throws, the
+ * exception is stored instead and rethrown by every call to Value().
+ *
+ * Compared to an `Atom<std::optional<T>>` filled in with CompareAndSet(),
+ * a Delay never takes a lock once it is realized, runs the function only
+ * once even when callers race, and hands out references rather than
+ * copies.
+ *
+ * @code
+ * Delay<Index> index([]() { return BuildIndex(); });
+ * const Index& current = index.Value();
+ * @endcode
+ *
+ * @tparam T The type of the value.
+ * @tparam Func The type of the function computing it.
+ *
+ * @see https://clojuredocs.org/clojure.core/delay Clojure delay
+ * @see http://ruby-concurrency.github.io/concurrent-ruby/master/Concurrent/Delay.html
+ *      Concurrent Ruby Delay
+ */
+template<typename T, typename Func = std::function<T()>>
+class Delay
+{
+public:
+
+  /**
+   * @param func Computes the value. Called at most once.
+   */
+  explicit Delay(Func func)
+    : mFunc(std::in_place, std::move(func))
+    {
+    }
+
+  Delay(const Delay&) = delete;
+  Delay& operator = (const Delay&) = delete;
+
+  /**
+   * Obtain the value, computing it first if this is the first call.
+   *
+   * @return The value, which lives as long as the delay.
+   *
+   * @throws The exception the function threw, if it did.
+   */
+  const T& Value()
+  {
+    if (mStatus.load(std::memory_order_acquire) == Realized)
+    {
+      return *mValue;
+    }
+
+    return realize();
+  }
+
+  /**
+   * @return `true` if the value has been computed, or the function threw.
+   */
+  bool IsRealized() const
+  {
+    Status status = mStatus.load(std::memory_order_acquire);
+    return status == Realized || status == Failed;
+  }
+
+private:
+
+  enum Status : uint8_t
+  {
+    Pending,
+    Running,
+    Realized,
+    Failed
+  };
+
+  /**
+   * The slow path of Value(): runs the function, waits for the thread
+   * which is running it, or rethrows its exception.
+   */
+  const T& realize()
+  {
+    Status expected = Pending;
+
+    if (mStatus.compare_exchange_strong(expected, Running,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire))
+    {
+      compute();
+    }
+    else if (expected == Running)
+    {
+      mWaiters.fetch_add(1, std::memory_order_seq_cst);
+      ParkingLot::Park(this, [this]() { return mStatus.load(std::memory_order_seq_cst) == Running; });
+      mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    if (mStatus.load(std::memory_order_acquire) == Failed)
+    {
+      std::rethrow_exception(mError);
+    }
+
+    return *mValue;
+  }
+
+  void compute()
+  {
+    Status status;
+
+    try
+    {
+      mValue.emplace((*mFunc)());
+      status = Realized;
+    }
+    catch (...)
+    {
+      mError = std::current_exception();
+      status = Failed;
+    }
+
+    // the function and whatever it captured are not needed any more
+    mFunc.reset();
+
+    mStatus.store(status, std::memory_order_seq_cst);
+
+    if (mWaiters.load(std::memory_order_seq_cst) != 0)
+    {
+      ParkingLot::UnparkAll(this);
+    }
+  }
+
+  std::atomic<Status> mStatus{ Pending };
+
+  std::atomic<uint32_t> mWaiters{ 0 };
+
+  std::optional<T> mValue;
+
+  std::exception_ptr mError;
+
+  std::optional<Func> mFunc;
+};
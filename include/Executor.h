@@ -0,0 +1,135 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+/**
+ * Runs tasks on behalf of the asynchronous features of the library, for
+ * example Atom watchers. An executor decides on which thread, and when, a
+ * task runs; the code submitting the task only promises that the task is
+ * safe to run on any thread.
+ *
+ * Executors are shared and usually live as long as the program. Anything
+ * holding a reference to an executor must not outlive it.
+ */
+class Executor
+{
+public:
+
+  /**
+   * A unit of work.
+   */
+  typedef std::function<void()> Task;
+
+  virtual ~Executor() {  }
+
+  /**
+   * Submits the task for execution.
+   *
+   * @param task The task to run.
+   */
+  virtual void Execute(Task task) = 0;
+};
+
+/**
+ * Runs every task immediately on the thread which submitted it. Exceptions
+ * thrown by the task propagate to the caller of Execute().
+ */
+class InlineExecutor : public Executor
+{
+public:
+
+  void Execute(Task task) override
+  {
+    task();
+  }
+
+  /**
+   * @return The executor shared by everyone who needs one.
+   */
+  static InlineExecutor& Instance()
+  {
+    static InlineExecutor executor;
+    return executor;
+  }
+};
+
+/**
+ * Runs tasks one at a time, in the order they were submitted, on a single
+ * background thread.
+ *
+ * The destructor runs every task already submitted and then joins the
+ * thread. As with `std::thread`, an exception escaping a task terminates
+ * the program.
+ */
+class ThreadExecutor : public Executor
+{
+public:
+
+  ThreadExecutor()
+    : mThread([this]() { run(); })
+    {
+    }
+
+  ThreadExecutor(const ThreadExecutor&) = delete;
+  ThreadExecutor& operator = (const ThreadExecutor&) = delete;
+
+  ~ThreadExecutor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStopping = true;
+    }
+
+    mCondition.notify_one();
+    mThread.join();
+  }
+
+  void Execute(Task task) override
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mTasks.push_back(std::move(task));
+    }
+
+    mCondition.notify_one();
+  }
+
+private:
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    for (;;)
+    {
+      mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+
+      if (mTasks.empty())
+      {
+        return;
+      }
+
+      Task task = std::move(mTasks.front());
+      mTasks.pop_front();
+
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mMutex;
+
+  std::condition_variable mCondition;
+
+  std::deque<Task> mTasks;
+
+  bool mStopping{ false };
+
+  std::thread mThread;
+};
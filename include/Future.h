@@ -0,0 +1,921 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <Executor.h>
+#include <LockPolicy.h>
+#include <ParkingLot.h>
+#include <ThreadPoolExecutor.h>
+
+template<typename T>
+class Future;
+
+template<typename T>
+class Promise;
+
+/**
+ * A type erased `void(Args...)` callable which is stored inside its owner
+ * when it fits into InlineSize bytes and on the heap otherwise. Lambdas
+ * capturing a few references or pointers fit.
+ */
+template<typename... Args>
+class InlineCallback
+{
+public:
+
+  static constexpr size_t InlineSize = 48;
+
+  InlineCallback() = default;
+
+  InlineCallback(const InlineCallback&) = delete;
+  InlineCallback& operator = (const InlineCallback&) = delete;
+
+  ~InlineCallback()
+  {
+    Reset();
+  }
+
+  /**
+   * Stores the callable, destroying any previous one.
+   */
+  template<typename F>
+  void Set(F&& func)
+  {
+    typedef typename std::decay<F>::type Func;
+
+    Reset();
+
+    if constexpr (sizeof(Func) <= InlineSize
+                  && alignof(Func) <= alignof(std::max_align_t)
+                  && std::is_nothrow_move_constructible<Func>::value)
+    {
+      new (&mStorage) Func(std::forward<F>(func));
+
+      mInvoke = [](void* storage, Args... args)
+      {
+        (*static_cast<Func*>(storage))(std::forward<Args>(args)...);
+      };
+
+      mDestroy = [](void* storage)
+      {
+        static_cast<Func*>(storage)->~Func();
+      };
+    }
+    else
+    {
+      *reinterpret_cast<Func**>(&mStorage) = new Func(std::forward<F>(func));
+
+      mInvoke = [](void* storage, Args... args)
+      {
+        (**static_cast<Func**>(storage))(std::forward<Args>(args)...);
+      };
+
+      mDestroy = [](void* storage)
+      {
+        delete *static_cast<Func**>(storage);
+      };
+    }
+  }
+
+  /**
+   * Destroys the stored callable.
+   */
+  void Reset()
+  {
+    if (mDestroy != nullptr)
+    {
+      mDestroy(&mStorage);
+      mInvoke = nullptr;
+      mDestroy = nullptr;
+    }
+  }
+
+  /**
+   * @return `true` if no callable is stored.
+   */
+  bool Empty() const
+  {
+    return mInvoke == nullptr;
+  }
+
+  void operator () (Args... args)
+  {
+    mInvoke(&mStorage, std::forward<Args>(args)...);
+  }
+
+private:
+
+  typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type mStorage;
+
+  void (*mInvoke)(void*, Args...){ nullptr };
+
+  void (*mDestroy)(void*){ nullptr };
+};
+
+/**
+ * The state shared by a Promise and its Futures: the outcome and the
+ * callbacks waiting for it, together in a single allocation which is freed
+ * when the last Promise or Future referring to it goes away.
+ *
+ * The first callback is stored inline. A state is rarely given more than
+ * one, so only additional callbacks cost an allocation.
+ */
+template<typename T>
+class FutureState
+{
+public:
+
+  typedef InlineCallback<FutureState&> Callback;
+
+  /**
+   * @return A new state with one reference, held by a Promise.
+   */
+  static FutureState* Create()
+  {
+    return new FutureState();
+  }
+
+  void AddReference()
+  {
+    mReferences.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void RemoveReference()
+  {
+    if (mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+      delete this;
+    }
+  }
+
+  void AddPromise()
+  {
+    mPromises.fetch_add(1, std::memory_order_relaxed);
+    AddReference();
+  }
+
+  /**
+   * Rejects the state with `broken_promise` when the last Promise goes away
+   * without resolving it.
+   */
+  void RemovePromise()
+  {
+    if (mPromises.fetch_sub(1, std::memory_order_acq_rel) == 1 && !Ready())
+    {
+      Reject(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+    }
+
+    RemoveReference();
+  }
+
+  bool Ready() const
+  {
+    return mStatus.load(std::memory_order_acquire) != Pending;
+  }
+
+  bool Fulfilled() const
+  {
+    return mStatus.load(std::memory_order_acquire) == IsFulfilled;
+  }
+
+  /**
+   * Only valid once Fulfilled().
+   */
+  const T& Value() const
+  {
+    return *mValue;
+  }
+
+  /**
+   * Only valid once the state is Ready() but not Fulfilled().
+   */
+  const std::exception_ptr& Error() const
+  {
+    return mError;
+  }
+
+  template<typename V>
+  bool Fulfill(V&& value)
+  {
+    return resolve([&]()
+    {
+      mValue.emplace(std::forward<V>(value));
+      return IsFulfilled;
+    });
+  }
+
+  bool Reject(std::exception_ptr error)
+  {
+    return resolve([&]()
+    {
+      mError = std::move(error);
+      return IsRejected;
+    });
+  }
+
+  /**
+   * Calls the function with the state once it is resolved: immediately if
+   * it already is, otherwise on the thread which resolves it.
+   */
+  template<typename F>
+  void OnResolved(F&& func)
+  {
+    {
+      std::lock_guard<SpinMutex> lock(mMutex);
+
+      if (mStatus.load(std::memory_order_relaxed) == Pending)
+      {
+        if (mFirst.Empty())
+        {
+          mFirst.Set(std::forward<F>(func));
+        }
+        else
+        {
+          mMore.emplace_back(new Callback());
+          mMore.back()->Set(std::forward<F>(func));
+        }
+
+        return;
+      }
+    }
+
+    func(*this);
+  }
+
+  /**
+   * Blocks the calling thread until the state is resolved or the deadline
+   * has passed.
+   *
+   * @return `true` if the state is resolved.
+   */
+  bool Wait(std::optional<ParkingLot::Clock::time_point> deadline)
+  {
+    if (Ready())
+    {
+      return true;
+    }
+
+    mWaiters.fetch_add(1, std::memory_order_seq_cst);
+
+    auto pending = [this]() { return mStatus.load(std::memory_order_seq_cst) == Pending; };
+
+    bool ready = deadline ? ParkingLot::ParkUntil(this, pending, *deadline)
+                          : ParkingLot::Park(this, pending);
+
+    mWaiters.fetch_sub(1, std::memory_order_relaxed);
+    return ready;
+  }
+
+private:
+
+  enum Status : uint8_t
+  {
+    Pending,
+    IsFulfilled,
+    IsRejected
+  };
+
+  FutureState() = default;
+
+  /**
+   * Stores the outcome unless there already is one, then runs the
+   * callbacks and wakes blocked threads.
+   */
+  template<typename F>
+  bool resolve(F&& store)
+  {
+    std::vector<std::unique_ptr<Callback>> more;
+
+    {
+      std::lock_guard<SpinMutex> lock(mMutex);
+
+      if (mStatus.load(std::memory_order_relaxed) != Pending)
+      {
+        return false;
+      }
+
+      mStatus.store(store(), std::memory_order_seq_cst);
+      more.swap(mMore);
+    }
+
+    if (mWaiters.load(std::memory_order_seq_cst) != 0)
+    {
+      ParkingLot::UnparkAll(this);
+    }
+
+    // no callbacks can be added any more, so they are ours to run
+    if (!mFirst.Empty())
+    {
+      mFirst(*this);
+      mFirst.Reset();
+    }
+
+    for (std::unique_ptr<Callback>& callback : more)
+    {
+      (*callback)(*this);
+    }
+
+    return true;
+  }
+
+  std::atomic<uint32_t> mReferences{ 1 };
+
+  std::atomic<uint32_t> mPromises{ 1 };
+
+  std::atomic<Status> mStatus{ Pending };
+
+  std::atomic<uint32_t> mWaiters{ 0 };
+
+  SpinMutex mMutex;
+
+  std::optional<T> mValue;
+
+  std::exception_ptr mError;
+
+  Callback mFirst;
+
+  std::vector<std::unique_ptr<Callback>> mMore;
+};
+
+/**
+ * The writing end of a Future. Resolving the promise, with a value or an
+ * exception, resolves every Future obtained from it. Only the first
+ * resolution counts.
+ *
+ * Copies of a Promise refer to the same state. If the last copy goes away
+ * without resolving it, the future is rejected with a `std::future_error`
+ * of `broken_promise`.
+ *
+ * @tparam T The type of the value.
+ */
+template<typename T>
+class Promise
+{
+public:
+
+  Promise()
+    : mState(FutureState<T>::Create())
+    {
+    }
+
+  Promise(const Promise& other)
+    : mState(other.mState)
+    {
+      mState->AddPromise();
+    }
+
+  // noexcept, so that callbacks capturing one still fit into an InlineCallback
+  Promise(Promise&& other) noexcept
+    : mState(other.mState)
+    {
+      other.mState = nullptr;
+    }
+
+  Promise& operator = (const Promise& other)
+  {
+    Promise copy(other);
+    std::swap(mState, copy.mState);
+    return *this;
+  }
+
+  Promise& operator = (Promise&& other) noexcept
+  {
+    std::swap(mState, other.mState);
+    return *this;
+  }
+
+  ~Promise()
+  {
+    if (mState != nullptr)
+    {
+      mState->RemovePromise();
+    }
+  }
+
+  /**
+   * @return A future resolved by this promise.
+   */
+  Future<T> GetFuture() const
+  {
+    return Future<T>(mState);
+  }
+
+  /**
+   * Fulfills the future with the value.
+   *
+   * @throws std::future_error If the future is already resolved.
+   */
+  template<typename V = T>
+  void SetValue(V&& value)
+  {
+    if (!TrySetValue(std::forward<V>(value)))
+    {
+      throw std::future_error(std::future_errc::promise_already_satisfied);
+    }
+  }
+
+  /**
+   * Rejects the future with the exception.
+   *
+   * @throws std::future_error If the future is already resolved.
+   */
+  void SetException(std::exception_ptr error)
+  {
+    if (!TrySetException(std::move(error)))
+    {
+      throw std::future_error(std::future_errc::promise_already_satisfied);
+    }
+  }
+
+  /**
+   * Works like SetValue() but returns `false` instead of throwing.
+   */
+  template<typename V = T>
+  bool TrySetValue(V&& value)
+  {
+    return mState->Fulfill(std::forward<V>(value));
+  }
+
+  /**
+   * Works like SetException() but returns `false` instead of throwing.
+   */
+  bool TrySetException(std::exception_ptr error)
+  {
+    return mState->Reject(std::move(error));
+  }
+
+  /**
+   * Fulfills the future with the result of the function or, if it throws,
+   * rejects it with the exception.
+   */
+  template<typename F>
+  void SetWith(F&& func)
+  {
+    try
+    {
+      TrySetValue(func());
+    }
+    catch (...)
+    {
+      TrySetException(std::current_exception());
+    }
+  }
+
+private:
+
+  FutureState<T>* mState;
+};
+
+/**
+ * The reading end of a Promise: a value, or an exception, which becomes
+ * available at some point.
+ *
+ * Unlike `std::future` a Future never has to be waited for. Then() chains a
+ * function which transforms the value into a new Future, OnSuccess() and
+ * OnFailure() register callbacks, ResolveInto() stores the value in an
+ * Atom, and WhenAll() and WhenAny() combine several futures. Callbacks run
+ * on the thread which resolves the promise, or immediately if it already
+ * is resolved, unless an Executor is given. Get() still blocks if needed.
+ *
+ * Every future costs one allocation, which holds the outcome and the first
+ * callback. Callbacks capturing no more than a few pointers are stored
+ * without allocating, so a chain of Then() calls allocates once per stage.
+ * Copies of a Future refer to the same state.
+ *
+ * @code
+ * Future<Config> config = Async([]() { return LoadConfig(); })
+ *   .Then([](const Config& config) { return Validate(config); })
+ *   .ResolveInto(currentConfig);
+ * @endcode
+ *
+ * @note Functions given an Executor other than InlineExecutor must be copy
+ *       constructible.
+ *
+ * @tparam T The type of the value.
+ *
+ * @see http://ruby-concurrency.github.io/concurrent-ruby/master/Concurrent/Promise.html
+ *      Concurrent Ruby Promise
+ */
+template<typename T>
+class Future
+{
+public:
+
+  typedef T ValueType;
+
+  Future(const Future& other)
+    : mState(other.mState)
+    {
+      mState->AddReference();
+    }
+
+  Future(Future&& other) noexcept
+    : mState(other.mState)
+    {
+      other.mState = nullptr;
+    }
+
+  Future& operator = (const Future& other)
+  {
+    Future copy(other);
+    std::swap(mState, copy.mState);
+    return *this;
+  }
+
+  Future& operator = (Future&& other) noexcept
+  {
+    std::swap(mState, other.mState);
+    return *this;
+  }
+
+  ~Future()
+  {
+    if (mState != nullptr)
+    {
+      mState->RemoveReference();
+    }
+  }
+
+  /**
+   * @return `true` if the future has a value or an exception.
+   */
+  bool Ready() const
+  {
+    return mState->Ready();
+  }
+
+  /**
+   * @return `true` if the future has a value.
+   */
+  bool Fulfilled() const
+  {
+    return mState->Fulfilled();
+  }
+
+  /**
+   * @return `true` if the future has an exception.
+   */
+  bool Rejected() const
+  {
+    return mState->Ready() && !mState->Fulfilled();
+  }
+
+  /**
+   * Blocks until the future is resolved.
+   *
+   * @return The value, which lives as long as the future.
+   *
+   * @throws The exception the future was rejected with.
+   */
+  const T& Get() const
+  {
+    Wait();
+
+    if (!mState->Fulfilled())
+    {
+      std::rethrow_exception(mState->Error());
+    }
+
+    return mState->Value();
+  }
+
+  /**
+   * Blocks until the future is resolved.
+   */
+  void Wait() const
+  {
+    mState->Wait(std::nullopt);
+  }
+
+  /**
+   * Blocks until the future is resolved or the timeout has passed.
+   *
+   * @return `true` if the future is resolved.
+   */
+  template<typename Rep, typename Period>
+  bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) const
+  {
+    return mState->Wait(ParkingLot::Clock::now()
+                        + std::chrono::duration_cast<ParkingLot::Clock::duration>(timeout));
+  }
+
+  /**
+   * Chains a function which transforms the value. If this future is
+   * rejected, or the function throws, the new future is rejected with the
+   * exception and the function is not called or its result is discarded.
+   *
+   * @param func Called as `func(value)`. Must not return `void`; use
+   *        OnSuccess() for side effects.
+   * @param executor Where the function runs.
+   *
+   * @return A future of the function's result.
+   */
+  template<typename F>
+  auto Then(F&& func, Executor& executor = InlineExecutor::Instance())
+    -> Future<typename std::invoke_result<F&, const T&>::type>
+  {
+    typedef typename std::invoke_result<F&, const T&>::type Result;
+    static_assert(!std::is_void<Result>::value,
+                  "Then() requires a function returning a value, use OnSuccess() for side effects");
+
+    Promise<Result> promise;
+    Future<Result> next = promise.GetFuture();
+
+    whenResolved([promise, func = std::forward<F>(func)](FutureState<T>& state) mutable
+    {
+      if (state.Fulfilled())
+      {
+        promise.SetWith([&]() { return func(state.Value()); });
+      }
+      else
+      {
+        promise.TrySetException(state.Error());
+      }
+    }, executor);
+
+    return next;
+  }
+
+  /**
+   * Registers a callback for the value. Not called if the future is
+   * rejected. The callback must not throw; an exception escaping it
+   * terminates the program.
+   *
+   * @param func Called as `func(value)`.
+   * @param executor Where the callback runs.
+   *
+   * @return This future, for chaining.
+   */
+  template<typename F>
+  Future& OnSuccess(F&& func, Executor& executor = InlineExecutor::Instance())
+  {
+    whenResolved([func = std::forward<F>(func)](FutureState<T>& state) mutable noexcept
+    {
+      if (state.Fulfilled())
+      {
+        func(state.Value());
+      }
+    }, executor);
+
+    return *this;
+  }
+
+  /**
+   * Registers a callback for the exception. Not called if the future is
+   * fulfilled. The callback must not throw; an exception escaping it
+   * terminates the program.
+   *
+   * @param func Called as `func(exception)` with a `std::exception_ptr`.
+   * @param executor Where the callback runs.
+   *
+   * @return This future, for chaining.
+   */
+  template<typename F>
+  Future& OnFailure(F&& func, Executor& executor = InlineExecutor::Instance())
+  {
+    whenResolved([func = std::forward<F>(func)](FutureState<T>& state) mutable noexcept
+    {
+      if (!state.Fulfilled())
+      {
+        func(state.Error());
+      }
+    }, executor);
+
+    return *this;
+  }
+
+  /**
+   * Resets the atom to the value once the future is fulfilled, on the
+   * thread which fulfills it. The atom must outlive the future's promise.
+   *
+   * An exception thrown by the reset, e.g. by the atom's validator or while
+   * copying the value, is caught and dropped and leaves the atom unchanged,
+   * since nobody would be there to receive it.
+   *
+   * @param atom Any Atom holding a `T`.
+   *
+   * @return This future, for chaining.
+   */
+  template<typename AtomType>
+  Future& ResolveInto(AtomType& atom)
+  {
+    return OnSuccess([&atom](const T& value) noexcept
+    {
+      try
+      {
+        atom.Reset(value);
+      }
+      catch (...)
+      {
+      }
+    });
+  }
+
+private:
+
+  template<typename U>
+  friend class Promise;
+
+  explicit Future(FutureState<T>* state)
+    : mState(state)
+    {
+      mState->AddReference();
+    }
+
+  /**
+   * Calls the function with the state once it is resolved, on the given
+   * executor. The inline executor is special cased so the callback is not
+   * wrapped in a `std::function`.
+   */
+  template<typename F>
+  void whenResolved(F&& func, Executor& executor)
+  {
+    if (&executor == &InlineExecutor::Instance())
+    {
+      mState->OnResolved(std::forward<F>(func));
+      return;
+    }
+
+    mState->OnResolved([func = std::forward<F>(func), &executor](FutureState<T>& state) mutable
+    {
+      state.AddReference();
+
+      executor.Execute([func, &state]() mutable
+      {
+        func(state);
+        state.RemoveReference();
+      });
+    });
+  }
+
+  FutureState<T>* mState;
+};
+
+/**
+ * @return A future which is already fulfilled with the value.
+ */
+template<typename T>
+Future<typename std::decay<T>::type> MakeFuture(T&& value)
+{
+  Promise<typename std::decay<T>::type> promise;
+  promise.SetValue(std::forward<T>(value));
+  return promise.GetFuture();
+}
+
+/**
+ * Runs the function on the executor.
+ *
+ * @param func Returns the value of the future.
+ * @param executor Where the function runs.
+ *
+ * @return A future fulfilled with the result of the function, or rejected
+ *         with what it threw.
+ */
+template<typename F>
+auto Async(F&& func, Executor& executor = SharedExecutor())
+  -> Future<typename std::invoke_result<F&>::type>
+{
+  typedef typename std::invoke_result<F&>::type Result;
+
+  Promise<Result> promise;
+  Future<Result> future = promise.GetFuture();
+
+  executor.Execute([promise, func = std::forward<F>(func)]() mutable
+  {
+    promise.SetWith(func);
+  });
+
+  return future;
+}
+
+/**
+ * Combines futures into one which is fulfilled with all their values, in
+ * order, once all of them are fulfilled. It is rejected as soon as any of
+ * them is rejected.
+ *
+ * @param futures The futures to wait for.
+ *
+ * @return A future of all the values.
+ */
+template<typename T>
+Future<std::vector<T>> WhenAll(const std::vector<Future<T>>& futures)
+{
+  struct Context
+  {
+    explicit Context(size_t count)
+      : values(count)
+      , remaining(count)
+      {
+      }
+
+    Promise<std::vector<T>> promise;
+    std::vector<std::optional<T>> values;
+    std::atomic<size_t> remaining;
+  };
+
+  auto context = std::make_shared<Context>(futures.size());
+  Future<std::vector<T>> result = context->promise.GetFuture();
+
+  if (futures.empty())
+  {
+    context->promise.SetValue(std::vector<T>());
+    return result;
+  }
+
+  for (size_t i = 0; i < futures.size(); i++)
+  {
+    Future<T> future(futures[i]);
+
+    future.OnSuccess([context, i](const T& value)
+    {
+      context->values[i].emplace(value);
+
+      if (context->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        std::vector<T> values;
+        values.reserve(context->values.size());
+
+        for (std::optional<T>& each : context->values)
+        {
+          values.push_back(std::move(*each));
+        }
+
+        context->promise.TrySetValue(std::move(values));
+      }
+    });
+
+    future.OnFailure([context](std::exception_ptr error)
+    {
+      context->promise.TrySetException(error);
+    });
+  }
+
+  return result;
+}
+
+/**
+ * Combines futures into one which is fulfilled with the value of whichever
+ * of them is fulfilled first. It is only rejected if all of them are, with
+ * the exception of the last one.
+ *
+ * @param futures The futures to wait for. Must not be empty.
+ *
+ * @return A future of the first value.
+ *
+ * @throws std::invalid_argument If there are no futures.
+ */
+template<typename T>
+Future<T> WhenAny(const std::vector<Future<T>>& futures)
+{
+  if (futures.empty())
+  {
+    throw std::invalid_argument("WhenAny requires at least one future");
+  }
+
+  struct Context
+  {
+    explicit Context(size_t count)
+      : remaining(count)
+      {
+      }
+
+    Promise<T> promise;
+    std::atomic<size_t> remaining;
+  };
+
+  auto context = std::make_shared<Context>(futures.size());
+  Future<T> result = context->promise.GetFuture();
+
+  for (const Future<T>& each : futures)
+  {
+    Future<T> future(each);
+
+    future.OnSuccess([context](const T& value)
+    {
+      context->promise.TrySetValue(value);
+    });
+
+    future.OnFailure([context](std::exception_ptr error)
+    {
+      if (context->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        context->promise.TrySetException(error);
+      }
+    });
+  }
+
+  return result;
+}
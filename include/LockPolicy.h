@@ -0,0 +1,772 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+/**
+ * Lock policies decide how an Atom protects its value.
+ *
+ * A lock policy is a small class owned by each Atom. It exposes exactly two
+ * operations, both of which receive the protected value and a function:
+ *
+ *  - `Read(value, func)` calls `func` with a `const` reference to the value
+ *    (or to a consistent copy of it) and returns whatever `func` returns.
+ *  - `Write(value, func)` calls `func` with a mutable reference to the value
+ *    while no other reader or writer can observe it and returns whatever
+ *    `func` returns.
+ *
+ * Because the policy controls the whole critical section rather than just
+ * a mutex, optimistic schemes such as SeqLock fit the same interface as the
+ * classic mutex based policies. Pick the policy which matches the read/write
+ * mix of each individual Atom:
+ *
+ *  - ExclusiveLock: a `std::mutex`. Cheapest when uncontended. The default.
+ *  - SharedLock: a `std::shared_mutex`. Readers proceed in parallel.
+ *  - SpinLock: a test-and-test-and-set spin lock. Best for very short
+ *    critical sections on dedicated cores.
+ *  - AdaptiveLock: spins briefly, then parks the thread in the kernel.
+ *  - SeqLock: readers never block and never write shared memory, they retry
+ *    when a writer intervened. Requires a trivially copyable value.
+ *  - FlatCombining: writers publish their update and one of them applies
+ *    all pending updates in a single pass. Best for heavily written atoms.
+ *  - LeftRight: keeps a second copy of the value so readers never wait,
+ *    however long a writer takes. Costs twice the memory and one extra
+ *    copy per write.
+ *  - LockFree: selects the `std::atomic<T>` specialization of Atom.
+ */
+
+/**
+ * The assumed size of a cache line, used to keep independently written data
+ * apart and avoid false sharing.
+ */
+constexpr std::size_t CacheLineSize = 64;
+
+/**
+ * Hints to the processor that the calling thread is in a spin-wait loop.
+ */
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * A test-and-test-and-set spin lock satisfying the standard Lockable
+ * requirements.
+ */
+class SpinMutex
+{
+public:
+
+  SpinMutex() = default;
+  SpinMutex(const SpinMutex&) = delete;
+  SpinMutex& operator = (const SpinMutex&) = delete;
+
+  void lock()
+  {
+    for (;;)
+    {
+      if (!mLocked.exchange(true, std::memory_order_acquire))
+      {
+        return;
+      }
+
+      while (mLocked.load(std::memory_order_relaxed))
+      {
+        CpuRelax();
+      }
+    }
+  }
+
+  bool try_lock()
+  {
+    return !mLocked.load(std::memory_order_relaxed)
+        && !mLocked.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock()
+  {
+    mLocked.store(false, std::memory_order_release);
+  }
+
+private:
+
+  std::atomic<bool> mLocked{ false };
+};
+
+/**
+ * A mutex which spins for a bounded number of iterations before parking the
+ * calling thread in the kernel. Short critical sections never pay for a
+ * context switch while long ones do not burn a core.
+ */
+class AdaptiveMutex
+{
+public:
+
+  /**
+   * The number of times lock() polls the mutex before blocking.
+   */
+  static constexpr int SpinCount = 100;
+
+  AdaptiveMutex() = default;
+  AdaptiveMutex(const AdaptiveMutex&) = delete;
+  AdaptiveMutex& operator = (const AdaptiveMutex&) = delete;
+
+  void lock()
+  {
+    for (int i = 0; i < SpinCount; i++)
+    {
+      if (mMutex.try_lock())
+      {
+        return;
+      }
+
+      CpuRelax();
+    }
+
+    mMutex.lock();
+  }
+
+  bool try_lock()
+  {
+    return mMutex.try_lock();
+  }
+
+  void unlock()
+  {
+    mMutex.unlock();
+  }
+
+private:
+
+  std::mutex mMutex;
+};
+
+/**
+ * Lock policy which serializes all readers and writers on a single
+ * Lockable.
+ *
+ * @tparam Mutex Any type satisfying the standard Lockable requirements.
+ */
+template<typename Mutex>
+class BasicLockPolicy
+{
+public:
+
+  template<typename T, typename F>
+  auto Read(const T& value, F&& func) -> decltype(func(value))
+  {
+    std::lock_guard<Mutex> lock(mMutex);
+    return func(value);
+  }
+
+  template<typename T, typename F>
+  auto Write(T& value, F&& func) -> decltype(func(value))
+  {
+    std::lock_guard<Mutex> lock(mMutex);
+    return func(value);
+  }
+
+private:
+
+  Mutex mMutex;
+};
+
+/**
+ * Lock policy which allows readers to proceed concurrently while writers
+ * get exclusive access.
+ */
+class SharedLock
+{
+public:
+
+  template<typename T, typename F>
+  auto Read(const T& value, F&& func) -> decltype(func(value))
+  {
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    return func(value);
+  }
+
+  template<typename T, typename F>
+  auto Write(T& value, F&& func) -> decltype(func(value))
+  {
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    return func(value);
+  }
+
+private:
+
+  std::shared_mutex mMutex;
+};
+
+/**
+ * Lock policy implementing a sequence lock.
+ *
+ * Writers serialize on a spin lock and increment a sequence counter before
+ * and after changing the value, so the counter is odd while a write is in
+ * progress. Readers copy the value and retry when the counter was odd or
+ * changed during the copy. Readers therefore never block each other and
+ * never write to memory shared with other threads, which lets reads of
+ * read-mostly values (configuration structs and the like) scale linearly
+ * with the number of cores.
+ *
+ * The write function runs against a private copy of the value while the
+ * sequence is still even, so readers keep reading the previous value for
+ * however long the function takes. Only publishing the result back makes
+ * readers retry, and writes which leave the value unchanged are not
+ * published at all.
+ *
+ * The sequence counter and the writer lock live on separate cache lines so
+ * writers queueing on the lock do not invalidate the line readers poll.
+ *
+ * The reader function is always called with a private copy of the value,
+ * never with the live value, so the value type must be trivially copyable.
+ *
+ * @note Because readers never wait, MultiAtom refuses atoms using this
+ *       policy at compile time.
+ */
+class SeqLock
+{
+public:
+
+  template<typename T, typename F>
+  auto Read(const T& value, F&& func) -> decltype(func(value))
+  {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock requires a trivially copyable value type");
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type buffer;
+
+    for (;;)
+    {
+      uint64_t before = mSequence.load(std::memory_order_acquire);
+
+      if (before & 1)
+      {
+        CpuRelax();
+        continue;
+      }
+
+      std::memcpy(&buffer, &value, sizeof(T));
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (mSequence.load(std::memory_order_relaxed) == before)
+      {
+        break;
+      }
+    }
+
+    return func(*reinterpret_cast<const T*>(&buffer));
+  }
+
+  template<typename T, typename F>
+  auto Write(T& value, F&& func) -> decltype(func(value))
+  {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock requires a trivially copyable value type");
+
+    std::lock_guard<SpinMutex> lock(mWriter);
+
+    T staged(value);
+    Publisher<T> publisher(mSequence, value, staged);
+
+    return func(staged);
+  }
+
+private:
+
+  /**
+   * Copies the staged value over the live value once the write function
+   * returns. The sequence is odd only while the copy is in progress. When
+   * the write function throws nothing is published.
+   */
+  template<typename T>
+  class Publisher
+  {
+  public:
+
+    Publisher(std::atomic<uint64_t>& sequence, T& value, const T& staged)
+      : mSequence(sequence)
+      , mValue(value)
+      , mStaged(staged)
+      , mExceptions(std::uncaught_exceptions())
+      {
+      }
+
+    ~Publisher()
+    {
+      if (std::uncaught_exceptions() > mExceptions
+          || std::memcmp(&mValue, &mStaged, sizeof(T)) == 0)
+      {
+        return;
+      }
+
+      uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+
+      mSequence.store(sequence + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      std::memcpy(&mValue, &mStaged, sizeof(T));
+
+      mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+  private:
+
+    std::atomic<uint64_t>& mSequence;
+    T& mValue;
+    const T& mStaged;
+    int mExceptions;
+  };
+
+  alignas(CacheLineSize) std::atomic<uint64_t> mSequence{ 0 };
+
+  alignas(CacheLineSize) SpinMutex mWriter;
+};
+
+/**
+ * Lock policy implementing flat combining.
+ *
+ * When many threads write to the same atom at once, handing a mutex from
+ * one to the next (and the value's cache lines along with it) dominates the
+ * run time. With flat combining each writer instead publishes its write
+ * function to a publication list and tries to become the combiner. The one
+ * thread which gets the lock applies every pending write function in
+ * publication order, in a single pass, while the others simply wait for
+ * their write to be marked done. The lock changes hands once per batch
+ * rather than once per write and the value stays in the combiner's cache.
+ *
+ * Publication records live on the waiting writers' stacks, so publishing a
+ * write never allocates. Exceptions thrown by a write function are handed
+ * back to the thread which published it. Readers take the lock directly.
+ *
+ * @see http://people.csail.mit.edu/shanir/publications/Flat%20Combining%20SPAA%2010.pdf
+ *      Flat Combining and the Synchronization-Parallelism Tradeoff
+ */
+class FlatCombining
+{
+public:
+
+  /**
+   * The number of times the combiner looks for newly published writes
+   * before releasing the lock.
+   */
+  static constexpr int CombiningPasses = 4;
+
+  template<typename T, typename F>
+  auto Read(const T& value, F&& func) -> decltype(func(value))
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return func(value);
+  }
+
+  template<typename T, typename F>
+  auto Write(T& value, F&& func) -> decltype(func(value))
+  {
+    Outcome<decltype(func(value))> outcome;
+    auto apply = [&]() { outcome.Run([&]() -> decltype(auto) { return func(value); }); };
+
+    Request request;
+    request.invoke = [](void* closure) { (*static_cast<decltype(apply)*>(closure))(); };
+    request.closure = &apply;
+
+    publish(request);
+    await(request);
+
+    if (request.exception)
+    {
+      std::rethrow_exception(request.exception);
+    }
+
+    return outcome.Get();
+  }
+
+private:
+
+  /**
+   * A published write function. Owned by the stack of the publishing thread.
+   */
+  struct Request
+  {
+    void (*invoke)(void* closure);
+    void* closure;
+    Request* next{ nullptr };
+    std::exception_ptr exception;
+    std::atomic<bool> done{ false };
+  };
+
+  /**
+   * Holds the return value of a write function until the publishing thread
+   * picks it up.
+   */
+  template<typename R>
+  struct Outcome
+  {
+    template<typename G>
+    void Run(G&& func)
+    {
+      mResult.emplace(func());
+    }
+
+    R Get()
+    {
+      return std::move(*mResult);
+    }
+
+    std::optional<R> mResult;
+  };
+
+  void publish(Request& request)
+  {
+    Request* head = mPending.load(std::memory_order_relaxed);
+
+    do
+    {
+      request.next = head;
+    }
+    while (!mPending.compare_exchange_weak(head, &request,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+  }
+
+  /**
+   * Waits until the request is done, becoming the combiner whenever the
+   * lock is free.
+   */
+  void await(Request& request)
+  {
+    for (int spins = 0; !request.done.load(std::memory_order_acquire); spins++)
+    {
+      if (mMutex.try_lock())
+      {
+        combine();
+        mMutex.unlock();
+        return;
+      }
+
+      if (spins < 64)
+      {
+        CpuRelax();
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+   * Applies every pending request. Must be called with the lock held.
+   */
+  void combine()
+  {
+    for (int pass = 0; pass < CombiningPasses; pass++)
+    {
+      Request* pending = mPending.exchange(nullptr, std::memory_order_acquire);
+
+      if (pending == nullptr)
+      {
+        return;
+      }
+
+      // the list is newest first, apply in publication order
+      Request* ordered = nullptr;
+
+      while (pending != nullptr)
+      {
+        Request* next = pending->next;
+        pending->next = ordered;
+        ordered = pending;
+        pending = next;
+      }
+
+      while (ordered != nullptr)
+      {
+        // the request may vanish as soon as it is marked done
+        Request* next = ordered->next;
+
+        try
+        {
+          ordered->invoke(ordered->closure);
+        }
+        catch (...)
+        {
+          ordered->exception = std::current_exception();
+        }
+
+        ordered->done.store(true, std::memory_order_release);
+        ordered = next;
+      }
+    }
+  }
+
+  std::mutex mMutex;
+
+  std::atomic<Request*> mPending{ nullptr };
+};
+
+template<>
+struct FlatCombining::Outcome<void>
+{
+  template<typename G>
+  void Run(G&& func)
+  {
+    func();
+  }
+
+  void Get()
+  {
+  }
+};
+
+/**
+ * Lock policy implementing the left-right technique.
+ *
+ * The policy keeps a second instance of the value next to the one owned by
+ * the atom. Readers always read whichever instance is currently active and
+ * never block: entering and leaving a read is one atomic increment and one
+ * decrement, so read latency is bounded no matter how long a writer runs.
+ *
+ * Writers serialize on a mutex and apply the write function to the
+ * inactive instance, where no reader can see it. They then make it the
+ * active one, wait until every reader still on the old instance has left,
+ * and bring the old instance up to date by copying the new one over it.
+ * The write function therefore runs exactly once. If it throws, the
+ * inactive instance is restored and nothing is published.
+ *
+ * The second instance is allocated on the first write. Until then readers
+ * use the atom's own instance.
+ *
+ * @note Costs twice the memory of the value and one extra copy per write.
+ *       Writers may wait for slow readers, readers never wait for writers.
+ *
+ * @note Because readers never wait, MultiAtom refuses atoms using this
+ *       policy at compile time. Each atom would switch to its new value on
+ *       its own and readers could see some atoms of an update changed and
+ *       others not yet.
+ *
+ * @see https://hal.science/hal-01207881/document
+ *      Left-Right: A Concurrency Control Technique with Wait-Free Population Oblivious Reads
+ */
+class LeftRight
+{
+public:
+
+  template<typename T, typename F>
+  auto Read(const T& value, F&& func) -> decltype(func(value))
+  {
+    int version = mVersion.load(std::memory_order_seq_cst);
+    ReadIndicator indicator(mReaders[version]);
+
+    return func(instance(value, mActive.load(std::memory_order_seq_cst)));
+  }
+
+  template<typename T, typename F>
+  auto Write(T& value, F&& func) -> decltype(func(value))
+  {
+    std::lock_guard<std::mutex> lock(mWriter);
+
+    if (!mCopy)
+    {
+      mCopy = std::make_shared<T>(value);
+    }
+
+    int active = mActive.load(std::memory_order_relaxed);
+    T& current = instance(value, active);
+    T& next = instance(value, 1 - active);
+
+    Synchronizer<T> synchronizer(*this, current, next);
+    return func(next);
+  }
+
+private:
+
+  /**
+   * Marks a reader as present on one of the two read indicators for as long
+   * as it exists.
+   */
+  class ReadIndicator
+  {
+  public:
+
+    explicit ReadIndicator(std::atomic<int64_t>& readers)
+      : mReaders(readers)
+      {
+        mReaders.fetch_add(1, std::memory_order_seq_cst);
+      }
+
+    ~ReadIndicator()
+    {
+      mReaders.fetch_sub(1, std::memory_order_release);
+    }
+
+  private:
+
+    std::atomic<int64_t>& mReaders;
+  };
+
+  /**
+   * Publishes the updated instance once the write function returns, then
+   * brings the other instance up to date. When the write function throws
+   * the updated instance is restored from the active one instead.
+   */
+  template<typename T>
+  class Synchronizer
+  {
+  public:
+
+    Synchronizer(LeftRight& policy, T& current, T& next)
+      : mPolicy(policy)
+      , mCurrent(current)
+      , mNext(next)
+      , mExceptions(std::uncaught_exceptions())
+      {
+      }
+
+    ~Synchronizer()
+    {
+      if (std::uncaught_exceptions() > mExceptions)
+      {
+        mNext = mCurrent;
+        return;
+      }
+
+      mPolicy.mActive.store(1 - mPolicy.mActive.load(std::memory_order_relaxed),
+                            std::memory_order_seq_cst);
+      mPolicy.awaitReaders();
+
+      mCurrent = mNext;
+    }
+
+  private:
+
+    LeftRight& mPolicy;
+    T& mCurrent;
+    T& mNext;
+    int mExceptions;
+  };
+
+  template<typename T>
+  T& instance(T& value, int index)
+  {
+    return index == 0 ? value : *static_cast<T*>(mCopy.get());
+  }
+
+  template<typename T>
+  const T& instance(const T& value, int index)
+  {
+    return index == 0 ? value : *static_cast<const T*>(mCopy.get());
+  }
+
+  /**
+   * Waits until no reader can still be using the previously active
+   * instance, by flipping readers over to the other read indicator and
+   * letting both drain in turn.
+   */
+  void awaitReaders()
+  {
+    int previous = mVersion.load(std::memory_order_relaxed);
+    int next = 1 - previous;
+
+    drain(mReaders[next]);
+    mVersion.store(next, std::memory_order_seq_cst);
+    drain(mReaders[previous]);
+  }
+
+  static void drain(const std::atomic<int64_t>& readers)
+  {
+    for (int spins = 0; readers.load(std::memory_order_seq_cst) != 0; spins++)
+    {
+      if (spins < 64)
+      {
+        CpuRelax();
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  struct alignas(CacheLineSize) Counter : std::atomic<int64_t>
+  {
+    Counter() : std::atomic<int64_t>(0) {  }
+  };
+
+  Counter mReaders[2];
+
+  alignas(CacheLineSize) std::atomic<int> mActive{ 0 };
+  std::atomic<int> mVersion{ 0 };
+
+  std::mutex mWriter;
+  std::shared_ptr<void> mCopy;
+};
+
+/**
+ * Lock policy which serializes readers and writers on a `std::mutex`.
+ */
+typedef BasicLockPolicy<std::mutex> ExclusiveLock;
+
+/**
+ * Lock policy which serializes readers and writers on a SpinMutex.
+ */
+typedef BasicLockPolicy<SpinMutex> SpinLock;
+
+/**
+ * Lock policy which serializes readers and writers on an AdaptiveMutex.
+ */
+typedef BasicLockPolicy<AdaptiveMutex> AdaptiveLock;
+
+/**
+ * Tag selecting the lock-free, `std::atomic<T>` based specialization of
+ * Atom. Only valid for value types where IsLockFreeAtom is `true`.
+ */
+struct LockFree
+{
+};
+
+/**
+ * Whether readers of an atom using the lock policy wait while a writer holds
+ * it. MultiAtom relies on this to make writes to several atoms visible as
+ * one: the atoms stay locked until every new value is in place.
+ *
+ * SeqLock and LeftRight publish each write as its own lock is released, so
+ * readers would see the atoms of a MultiAtom update change one at a time.
+ * LockFree has no lock at all.
+ */
+template<typename LockPolicy>
+struct ReadersWaitForWriters : std::true_type
+{
+};
+
+template<>
+struct ReadersWaitForWriters<SeqLock> : std::false_type
+{
+};
+
+template<>
+struct ReadersWaitForWriters<LeftRight> : std::false_type
+{
+};
+
+template<>
+struct ReadersWaitForWriters<LockFree> : std::false_type
+{
+};
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include <Atom.h>
+
+/**
+ * Updates several atoms together, as one atomic operation, without an
+ * external mutex serializing unrelated work.
+ *
+ * The atoms are write locked one after the other in a global order (their
+ * addresses), so two threads updating overlapping sets of atoms can never
+ * deadlock no matter in which order they pass them. The update function is
+ * called with the current values of all atoms and returns a tuple with the
+ * new values, in the same order. Every new value is checked against the
+ * validator of its own atom. Either all new values are valid and all of them
+ * are written, or none is.
+ *
+ * Watchers of the atoms are called once all of them are unlocked, so a
+ * watcher may read any of the atoms and sees the whole update.
+ *
+ * Works with every lock policy whose readers wait for writers (see
+ * ReadersWaitForWriters). SeqLock and LeftRight are rejected at compile
+ * time: their readers never wait, and each atom publishes its new value as
+ * its own lock is released, so readers would see a half done update.
+ * LockFree is rejected because it has no lock that could be held across
+ * atoms.
+ *
+ * @see ResetMany()
+ * @see SwapMany()
+ */
+class MultiAtom
+{
+public:
+
+  /**
+   * Locks all atoms, calls the update function once with their current
+   * values and writes the new values if all of them are valid. Like
+   * Atom::Reset() the function runs exactly once, with every write lock held.
+   *
+   * @param func The function calculating the new values from the current
+   *        ones. Returns a `std::tuple` of new values.
+   * @param atoms The atoms to update. Each atom may be given only once.
+   *
+   * @return `true` if the values are changed else `false`.
+   *
+   * @throws std::invalid_argument if the same atom is given more than once.
+   */
+  template<typename F, typename... Atoms>
+  static bool ResetMany(F&& func, Atoms&... atoms)
+  {
+    return resetMany(func, std::index_sequence_for<Atoms...>(), atoms...);
+  }
+
+  /**
+   * Reads the current values and versions of all atoms without holding any
+   * lock, calls the update function and then locks all atoms just long enough
+   * to check that none has been written in the meantime and write the new
+   * values. If any atom has been written the whole update is retried, so the
+   * function must be free of side effects.
+   *
+   * @note Unlike Atom::Swap() a new value which fails validation is not
+   *       retried. The update is rejected as a whole instead.
+   *
+   * @param func The function calculating the new values from the current
+   *        ones. Returns a `std::tuple` of new values.
+   * @param atoms The atoms to update. Each atom may be given only once.
+   *
+   * @return `true` if the values are changed, `false` if they were rejected
+   *         as invalid.
+   *
+   * @throws std::invalid_argument if the same atom is given more than once.
+   */
+  template<typename F, typename... Atoms>
+  static bool SwapMany(F&& func, Atoms&... atoms)
+  {
+    return swapMany(func, std::index_sequence_for<Atoms...>(), atoms...);
+  }
+
+private:
+
+  struct Context;
+
+  template<typename AtomType>
+  struct LockPolicyOf;
+
+  template<typename T, typename LockPolicy, typename Validator, typename StatsPolicy>
+  struct LockPolicyOf<Atom<T, LockPolicy, Validator, StatsPolicy>>
+  {
+    typedef LockPolicy Type;
+  };
+
+  /**
+   * One atom to lock, along with how to lock it.
+   */
+  struct Entry
+  {
+    void* atom;
+    void (*write)(void* atom, Context& context, size_t position);
+    size_t index;
+  };
+
+  /**
+   * Everything the chain of nested write locks needs. The locked states and
+   * the changes to tell watchers about are stored by the position of their
+   * atom in the argument list.
+   */
+  struct Context
+  {
+    Entry* entries;
+    size_t count;
+    void** states;
+    void** changes;
+    void (*body)(void* closure);
+    void* closure;
+  };
+
+  template<typename F, typename... Atoms, size_t... I>
+  static bool resetMany(F& func, std::index_sequence<I...>, Atoms&... atoms)
+  {
+    return lockAll([&](auto&... states)
+    {
+      auto newValues = func(static_cast<const decltype(states.value)&>(states.value)...);
+
+      if (!(atoms.isValid(std::get<I>(newValues)) && ...))
+      {
+        return false;
+      }
+
+      (states.set(std::move(std::get<I>(newValues))), ...);
+      return true;
+    }, std::index_sequence<I...>(), atoms...);
+  }
+
+  template<typename F, typename... Atoms, size_t... I>
+  static bool swapMany(F& func, std::index_sequence<I...>, Atoms&... atoms)
+  {
+    for (;;)
+    {
+      auto current = std::make_tuple(atoms.ValueWithVersion()...);
+      auto newValues = func(static_cast<const decltype(std::get<I>(current).first)&>(
+                              std::get<I>(current).first)...);
+
+      if (!(atoms.isValid(std::get<I>(newValues)) && ...))
+      {
+        return false;
+      }
+
+      bool committed = lockAll([&](auto&... states)
+      {
+        if (!((states.version == std::get<I>(current).second) && ...))
+        {
+          return false;
+        }
+
+        (states.set(std::move(std::get<I>(newValues))), ...);
+        return true;
+      }, std::index_sequence<I...>(), atoms...);
+
+      if (committed)
+      {
+        return true;
+      }
+    }
+  }
+
+  /**
+   * Write locks all atoms in address order, calls the body with their locked
+   * states in argument order, and returns what the body returned. Watchers
+   * are told about the changes once every lock has been released.
+   */
+  template<typename Body, typename... Atoms, size_t... I>
+  static bool lockAll(Body&& body, std::index_sequence<I...>, Atoms&... atoms)
+  {
+    static_assert((ReadersWaitForWriters<typename LockPolicyOf<Atoms>::Type>::value && ...),
+                  "MultiAtom requires lock policies whose readers wait for writers");
+
+    constexpr size_t count = sizeof...(Atoms);
+
+    Entry entries[count] = { Entry{ &atoms, &writeHook<Atoms>, I }... };
+    void* states[count] = {};
+
+    std::tuple<typename Atoms::Change...> changes;
+    void* changed[count] = { &std::get<I>(changes)... };
+
+    std::sort(entries, entries + count, [](const Entry& left, const Entry& right)
+    {
+      return std::less<void*>()(left.atom, right.atom);
+    });
+
+    for (size_t i = 1; i < count; i++)
+    {
+      if (entries[i].atom == entries[i - 1].atom)
+      {
+        throw std::invalid_argument("the same atom was given more than once");
+      }
+    }
+
+    bool result{ false };
+
+    auto inner = [&]()
+    {
+      result = body(*static_cast<typename Atoms::State*>(states[I])...);
+    };
+
+    Context context{ entries, count, states, changed,
+                     [](void* closure){ (*static_cast<decltype(inner)*>(closure))(); },
+                     &inner };
+
+    lockFrom(context, 0);
+
+    (atoms.notifyWatches(std::get<I>(changes)), ...);
+
+    return result;
+  }
+
+  static void lockFrom(Context& context, size_t position)
+  {
+    if (position == context.count)
+    {
+      context.body(context.closure);
+      return;
+    }
+
+    Entry& entry = context.entries[position];
+    entry.write(entry.atom, context, position);
+  }
+
+  template<typename AtomType>
+  static void writeHook(void* atom, Context& context, size_t position)
+  {
+    AtomType& subject = *static_cast<AtomType*>(atom);
+    size_t index = context.entries[position].index;
+
+    auto next = [&](typename AtomType::State& state)
+    {
+      context.states[index] = &state;
+      lockFrom(context, position + 1);
+    };
+
+    subject.recordingWrite(next, *static_cast<typename AtomType::Change*>(context.changes[index]));
+  }
+};
+
+/**
+ * Atomically updates several atoms together. See MultiAtom::ResetMany().
+ */
+template<typename F, typename... Atoms>
+bool ResetMany(F&& func, Atoms&... atoms)
+{
+  return MultiAtom::ResetMany(func, atoms...);
+}
+
+/**
+ * Atomically updates several atoms together. See MultiAtom::SwapMany().
+ */
+template<typename F, typename... Atoms>
+bool SwapMany(F&& func, Atoms&... atoms)
+{
+  return MultiAtom::SwapMany(func, atoms...);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <LockPolicy.h>
+
+/**
+ * A global table of wait queues keyed by address, which lets any object
+ * block threads until it changes without owning a mutex or condition
+ * variable of its own.
+ *
+ * Threads park on an address and are woken by a call to UnparkAll() with
+ * the same address. Addresses are hashed onto a fixed number of buckets,
+ * each with its own mutex and condition variable, so unrelated objects
+ * occasionally share a bucket. Parked threads therefore re-check their
+ * condition after every wakeup, and waking an address may wake threads
+ * parked on other addresses in the same bucket. Both are harmless.
+ *
+ * To avoid missing a wakeup the object keeps a count of parked threads.
+ * A waiter increments it before calling Park(); a writer changes the
+ * object first and calls UnparkAll() only when the count is non-zero.
+ * Use sequentially consistent operations on both sides.
+ *
+ * @see https://webkit.org/blog/6161/locking-in-webkit/
+ *      Locking in WebKit
+ */
+class ParkingLot
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Blocks the calling thread for as long as `shouldPark()` returns `true`.
+   * The condition is evaluated while holding the bucket lock, so a call to
+   * UnparkAll() after the condition has become false cannot be missed.
+   *
+   * @param address The address to park on.
+   * @param shouldPark Returns `true` while the thread should keep waiting.
+   *
+   * @return Always `true`.
+   */
+  template<typename F>
+  static bool Park(const void* address, F&& shouldPark)
+  {
+    Bucket& bucket = bucketFor(address);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+
+    while (shouldPark())
+    {
+      bucket.condition.wait(lock);
+    }
+
+    return true;
+  }
+
+  /**
+   * Works like Park() but gives up at the deadline.
+   *
+   * @param address The address to park on.
+   * @param shouldPark Returns `true` while the thread should keep waiting.
+   * @param deadline The point in time at which to stop waiting.
+   *
+   * @return `false` if the deadline passed while the condition still held
+   *         else `true`.
+   */
+  template<typename F>
+  static bool ParkUntil(const void* address, F&& shouldPark, Clock::time_point deadline)
+  {
+    Bucket& bucket = bucketFor(address);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+
+    while (shouldPark())
+    {
+      if (bucket.condition.wait_until(lock, deadline) == std::cv_status::timeout)
+      {
+        return !shouldPark();
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Wakes every thread parked on the given address.
+   *
+   * @param address The address threads are parked on.
+   */
+  static void UnparkAll(const void* address)
+  {
+    Bucket& bucket = bucketFor(address);
+
+    {
+      std::lock_guard<std::mutex> lock(bucket.mutex);
+    }
+
+    bucket.condition.notify_all();
+  }
+
+private:
+
+  static constexpr size_t BucketCount = 64;
+
+  struct alignas(CacheLineSize) Bucket
+  {
+    std::mutex mutex;
+    std::condition_variable condition;
+  };
+
+  static Bucket& bucketFor(const void* address)
+  {
+    static Bucket buckets[BucketCount];
+
+    uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(address));
+    hash ^= hash >> 17;
+    hash *= 0x9E3779B97F4A7C15ull;
+
+    return buckets[(hash >> 32) % BucketCount];
+  }
+};
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * An immutable hash map with structural sharing, designed to live inside an
+ * Atom.
+ *
+ * Updating a `std::map` held by an Atom through Swap() copies the whole map
+ * for every single key which changes. A PersistentMap never changes once
+ * built. Set() and Erase() return a new map which shares all but O(log n)
+ * of its nodes with the original, so copying one costs a pointer and
+ * updating one costs a handful of small allocations. Old versions stay valid
+ * for as long as anybody holds them and are reclaimed automatically.
+ *
+ * Internally this is a hash array mapped trie (HAMT) in the compressed CHAMP
+ * layout: every node consumes 5 bits of the hash and keeps its inline
+ * entries and its child nodes in two separate, bitmap indexed arrays. Keys
+ * whose hashes are identical end up in a collision node at the bottom of the
+ * trie. Erasing keeps the trie in its canonical, most compact form.
+ *
+ * Equality first compares the roots of the tries. Two maps derived from each
+ * other without changes therefore compare equal in constant time.
+ *
+ * @tparam K The key type.
+ * @tparam V The value type.
+ * @tparam Hash The hash function for keys.
+ * @tparam KeyEqual The equality function for keys.
+ *
+ * @see https://michael.steindorfer.name/publications/oopsla15.pdf
+ *      Optimizing Hash-Array Mapped Tries for Fast and Lean Immutable JVM Collections
+ */
+template<typename K,
+         typename V,
+         typename Hash = std::hash<K>,
+         typename KeyEqual = std::equal_to<K>>
+class PersistentMap
+{
+  static constexpr unsigned Bits = 5;
+  static constexpr size_t Mask = (size_t(1) << Bits) - 1;
+  static constexpr unsigned HashBits = sizeof(size_t) * 8;
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+public:
+
+  typedef std::pair<K, V> Entry;
+
+  /**
+   * A function called for every entry of the map.
+   *
+   * @param key The key.
+   * @param value The value.
+   */
+  typedef std::function<void(const K& key, const V& value)> ForEachFunc;
+
+  /**
+   * Constructs an empty map.
+   */
+  PersistentMap()
+    : mSize(0)
+    {
+    }
+
+  /**
+   * Constructs a map holding the given entries. Later entries win over
+   * earlier entries with the same key.
+   *
+   * @param entries The initial entries.
+   */
+  PersistentMap(std::initializer_list<Entry> entries)
+    : PersistentMap()
+    {
+      for (const Entry& entry : entries)
+      {
+        *this = Set(entry.first, entry.second);
+      }
+    }
+
+  /**
+   * @return The number of entries.
+   */
+  size_t Size() const
+  {
+    return mSize;
+  }
+
+  /**
+   * @return `true` if the map has no entries else `false`.
+   */
+  bool Empty() const
+  {
+    return mSize == 0;
+  }
+
+  /**
+   * Look up the value for the given key.
+   *
+   * @param key The key.
+   *
+   * @return A pointer to the value, valid for as long as this map is, or
+   *         `nullptr` if the key is not present.
+   */
+  const V* Find(const K& key) const
+  {
+    if (!mRoot)
+    {
+      return nullptr;
+    }
+
+    return find(*mRoot, key, Hash()(key), 0);
+  }
+
+  /**
+   * @return `true` if the key is present else `false`.
+   */
+  bool Contains(const K& key) const
+  {
+    return Find(key) != nullptr;
+  }
+
+  /**
+   * Look up the value for the given key.
+   *
+   * @param key The key.
+   *
+   * @return The value.
+   *
+   * @throws std::out_of_range if the key is not present.
+   */
+  const V& At(const K& key) const
+  {
+    const V* value = Find(key);
+
+    if (value == nullptr)
+    {
+      throw std::out_of_range("PersistentMap key not found");
+    }
+
+    return *value;
+  }
+
+  /**
+   * @return A map in which the given key maps to the given value.
+   */
+  PersistentMap Set(const K& key, V value) const
+  {
+    PersistentMap result(*this);
+    bool added{ false };
+
+    if (!mRoot)
+    {
+      auto root = std::make_shared<Node>();
+      root->dataMap = bitFor(Hash()(key), 0);
+      root->entries.emplace_back(key, std::move(value));
+      result.mRoot = std::move(root);
+      added = true;
+    }
+    else
+    {
+      result.mRoot = set(mRoot, key, std::move(value), Hash()(key), 0, added);
+    }
+
+    if (added)
+    {
+      result.mSize++;
+    }
+
+    return result;
+  }
+
+  /**
+   * @return A map without the given key. The map itself when the key is not
+   *         present.
+   */
+  PersistentMap Erase(const K& key) const
+  {
+    if (!mRoot)
+    {
+      return *this;
+    }
+
+    bool removed{ false };
+    NodePtr root = erase(mRoot, key, Hash()(key), 0, removed);
+
+    if (!removed)
+    {
+      return *this;
+    }
+
+    PersistentMap result(*this);
+    result.mSize--;
+    result.mRoot = (root->entries.empty() && root->children.empty()) ? NodePtr() : root;
+    return result;
+  }
+
+  /**
+   * Calls the function for every entry, in no particular order.
+   *
+   * @param func The function to call.
+   */
+  template<typename F>
+  void ForEach(F&& func) const
+  {
+    if (mRoot)
+    {
+      forEach(*mRoot, func);
+    }
+  }
+
+  /**
+   * Compares two maps entry by entry, skipping the comparison entirely when
+   * both share the same trie.
+   */
+  bool operator == (const PersistentMap& other) const
+  {
+    if (mRoot == other.mRoot)
+    {
+      return true;
+    }
+
+    if (mSize != other.mSize)
+    {
+      return false;
+    }
+
+    bool equal{ true };
+
+    ForEach([&](const K& key, const V& value)
+    {
+      if (equal)
+      {
+        const V* otherValue = other.Find(key);
+        equal = otherValue != nullptr && *otherValue == value;
+      }
+    });
+
+    return equal;
+  }
+
+  bool operator != (const PersistentMap& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+
+  /**
+   * A trie node. `dataMap` marks the hash fragments stored inline in
+   * `entries`, `nodeMap` the ones stored in `children`. Below the last hash
+   * fragment a node is a collision node: both maps are empty and `entries`
+   * is searched linearly.
+   */
+  struct Node
+  {
+    uint32_t dataMap{ 0 };
+    uint32_t nodeMap{ 0 };
+    std::vector<Entry> entries;
+    std::vector<NodePtr> children;
+  };
+
+  static uint32_t bitFor(size_t hash, unsigned shift)
+  {
+    return uint32_t(1) << ((hash >> shift) & Mask);
+  }
+
+  static size_t indexFor(uint32_t map, uint32_t bit)
+  {
+    return popCount(map & (bit - 1));
+  }
+
+  static size_t popCount(uint32_t bits)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_popcount(bits));
+#else
+    bits = bits - ((bits >> 1) & 0x55555555);
+    bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+    return static_cast<size_t>((((bits + (bits >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+#endif
+  }
+
+  static bool isCollision(unsigned shift)
+  {
+    return shift >= HashBits;
+  }
+
+  static const V* find(const Node& node, const K& key, size_t hash, unsigned shift)
+  {
+    if (isCollision(shift))
+    {
+      for (const Entry& entry : node.entries)
+      {
+        if (KeyEqual()(entry.first, key))
+        {
+          return &entry.second;
+        }
+      }
+
+      return nullptr;
+    }
+
+    uint32_t bit = bitFor(hash, shift);
+
+    if (node.dataMap & bit)
+    {
+      const Entry& entry = node.entries[indexFor(node.dataMap, bit)];
+      return KeyEqual()(entry.first, key) ? &entry.second : nullptr;
+    }
+
+    if (node.nodeMap & bit)
+    {
+      return find(*node.children[indexFor(node.nodeMap, bit)], key, hash, shift + Bits);
+    }
+
+    return nullptr;
+  }
+
+  static NodePtr set(const NodePtr& node, const K& key, V value,
+                     size_t hash, unsigned shift, bool& added)
+  {
+    auto result = std::make_shared<Node>(*node);
+
+    if (isCollision(shift))
+    {
+      for (Entry& entry : result->entries)
+      {
+        if (KeyEqual()(entry.first, key))
+        {
+          entry.second = std::move(value);
+          return result;
+        }
+      }
+
+      result->entries.emplace_back(key, std::move(value));
+      added = true;
+      return result;
+    }
+
+    uint32_t bit = bitFor(hash, shift);
+
+    if (node->dataMap & bit)
+    {
+      size_t index = indexFor(node->dataMap, bit);
+      const Entry& existing = node->entries[index];
+
+      if (KeyEqual()(existing.first, key))
+      {
+        result->entries[index].second = std::move(value);
+        return result;
+      }
+
+      // two keys share this fragment, push both one level down
+      NodePtr child = merge(existing, Hash()(existing.first),
+                            Entry(key, std::move(value)), hash, shift + Bits);
+
+      result->entries.erase(result->entries.begin() + index);
+      result->dataMap ^= bit;
+      result->nodeMap |= bit;
+      result->children.insert(result->children.begin() + indexFor(result->nodeMap, bit),
+                              std::move(child));
+      added = true;
+      return result;
+    }
+
+    if (node->nodeMap & bit)
+    {
+      size_t index = indexFor(node->nodeMap, bit);
+      result->children[index] = set(node->children[index], key, std::move(value),
+                                    hash, shift + Bits, added);
+      return result;
+    }
+
+    result->dataMap |= bit;
+    result->entries.insert(result->entries.begin() + indexFor(result->dataMap, bit),
+                           Entry(key, std::move(value)));
+    added = true;
+    return result;
+  }
+
+  /**
+   * Builds the smallest subtrie holding both entries.
+   */
+  static NodePtr merge(const Entry& first, size_t firstHash,
+                       Entry second, size_t secondHash, unsigned shift)
+  {
+    auto node = std::make_shared<Node>();
+
+    if (isCollision(shift))
+    {
+      node->entries.push_back(first);
+      node->entries.push_back(std::move(second));
+      return node;
+    }
+
+    uint32_t firstBit = bitFor(firstHash, shift);
+    uint32_t secondBit = bitFor(secondHash, shift);
+
+    if (firstBit == secondBit)
+    {
+      node->nodeMap = firstBit;
+      node->children.push_back(merge(first, firstHash, std::move(second), secondHash, shift + Bits));
+    }
+    else
+    {
+      node->dataMap = firstBit | secondBit;
+
+      if (firstBit < secondBit)
+      {
+        node->entries.push_back(first);
+        node->entries.push_back(std::move(second));
+      }
+      else
+      {
+        node->entries.push_back(std::move(second));
+        node->entries.push_back(first);
+      }
+    }
+
+    return node;
+  }
+
+  static NodePtr erase(const NodePtr& node, const K& key,
+                       size_t hash, unsigned shift, bool& removed)
+  {
+    if (isCollision(shift))
+    {
+      for (size_t i = 0; i < node->entries.size(); i++)
+      {
+        if (KeyEqual()(node->entries[i].first, key))
+        {
+          auto result = std::make_shared<Node>(*node);
+          result->entries.erase(result->entries.begin() + i);
+          removed = true;
+          return result;
+        }
+      }
+
+      return node;
+    }
+
+    uint32_t bit = bitFor(hash, shift);
+
+    if (node->dataMap & bit)
+    {
+      size_t index = indexFor(node->dataMap, bit);
+
+      if (!KeyEqual()(node->entries[index].first, key))
+      {
+        return node;
+      }
+
+      auto result = std::make_shared<Node>(*node);
+      result->entries.erase(result->entries.begin() + index);
+      result->dataMap ^= bit;
+      removed = true;
+      return result;
+    }
+
+    if (node->nodeMap & bit)
+    {
+      size_t index = indexFor(node->nodeMap, bit);
+      NodePtr child = erase(node->children[index], key, hash, shift + Bits, removed);
+
+      if (!removed)
+      {
+        return node;
+      }
+
+      auto result = std::make_shared<Node>(*node);
+
+      if (child->children.empty() && child->entries.size() == 1)
+      {
+        // a single remaining entry moves back up into this node
+        result->children.erase(result->children.begin() + index);
+        result->nodeMap ^= bit;
+        result->dataMap |= bit;
+        result->entries.insert(result->entries.begin() + indexFor(result->dataMap, bit),
+                               child->entries[0]);
+      }
+      else
+      {
+        result->children[index] = std::move(child);
+      }
+
+      return result;
+    }
+
+    return node;
+  }
+
+  template<typename F>
+  static void forEach(const Node& node, F& func)
+  {
+    for (const Entry& entry : node.entries)
+    {
+      func(entry.first, entry.second);
+    }
+
+    for (const NodePtr& child : node.children)
+    {
+      forEach(*child, func);
+    }
+  }
+
+  size_t mSize;
+  NodePtr mRoot;
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+
+#include <PersistentMap.h>
+
+/**
+ * An immutable hash set with structural sharing, designed to live inside an
+ * Atom. Insert() and Erase() return a new set in O(log n) which shares
+ * almost all of its structure with the original.
+ *
+ * A thin wrapper around PersistentMap, see there for the details.
+ *
+ * @tparam K The key type.
+ * @tparam Hash The hash function for keys.
+ * @tparam KeyEqual The equality function for keys.
+ */
+template<typename K,
+         typename Hash = std::hash<K>,
+         typename KeyEqual = std::equal_to<K>>
+class PersistentSet
+{
+  /**
+   * The value stored for every key of the underlying map.
+   */
+  struct Present
+  {
+    bool operator == (const Present&) const { return true; }
+  };
+
+  typedef PersistentMap<K, Present, Hash, KeyEqual> Map;
+
+public:
+
+  /**
+   * Constructs an empty set.
+   */
+  PersistentSet()
+    {
+    }
+
+  /**
+   * Constructs a set holding the given keys.
+   *
+   * @param keys The initial keys.
+   */
+  PersistentSet(std::initializer_list<K> keys)
+    {
+      for (const K& key : keys)
+      {
+        mMap = mMap.Set(key, Present());
+      }
+    }
+
+  /**
+   * @return The number of keys.
+   */
+  size_t Size() const
+  {
+    return mMap.Size();
+  }
+
+  /**
+   * @return `true` if the set has no keys else `false`.
+   */
+  bool Empty() const
+  {
+    return mMap.Empty();
+  }
+
+  /**
+   * @return `true` if the key is present else `false`.
+   */
+  bool Contains(const K& key) const
+  {
+    return mMap.Contains(key);
+  }
+
+  /**
+   * @return A set which contains the given key.
+   */
+  PersistentSet Insert(const K& key) const
+  {
+    return PersistentSet(mMap.Set(key, Present()));
+  }
+
+  /**
+   * @return A set which does not contain the given key.
+   */
+  PersistentSet Erase(const K& key) const
+  {
+    return PersistentSet(mMap.Erase(key));
+  }
+
+  /**
+   * Calls the function for every key, in no particular order.
+   *
+   * @param func The function to call.
+   */
+  template<typename F>
+  void ForEach(F&& func) const
+  {
+    mMap.ForEach([&func](const K& key, const Present&){ func(key); });
+  }
+
+  bool operator == (const PersistentSet& other) const
+  {
+    return mMap == other.mMap;
+  }
+
+  bool operator != (const PersistentSet& other) const
+  {
+    return mMap != other.mMap;
+  }
+
+private:
+
+  explicit PersistentSet(const Map& map)
+    : mMap(map)
+    {
+    }
+
+  Map mMap;
+};
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * An immutable vector with structural sharing, designed to live inside an
+ * Atom.
+ *
+ * Updating a `std::vector` held by an Atom through Swap() copies the whole
+ * vector for every change. A PersistentVector never changes once built.
+ * PushBack(), Set(), and PopBack() return a new vector which shares all but
+ * O(log n) of its nodes with the original, so copying one costs a pointer
+ * and updating one costs a handful of small allocations. Old versions stay
+ * valid for as long as anybody holds them and are reclaimed automatically.
+ *
+ * Internally this is a bit-partitioned trie with a branching factor of 32
+ * plus a separate tail holding the last (up to) 32 elements, as in Clojure.
+ * Lookups are O(log32 n), which is at most 7 levels for any vector which
+ * fits into memory, and appends are amortized O(1).
+ *
+ * Equality first compares the roots of the tries. Two vectors derived from
+ * each other without changes therefore compare equal in constant time.
+ *
+ * @see http://hypirion.com/musings/understanding-persistent-vector-pt-1
+ *      Understanding Clojure's Persistent Vectors
+ */
+template<typename T>
+class PersistentVector
+{
+  static constexpr unsigned Bits = 5;
+  static constexpr size_t Width = size_t(1) << Bits;
+  static constexpr size_t Mask = Width - 1;
+
+  struct Node;
+  typedef std::shared_ptr<const Node> NodePtr;
+
+  /**
+   * A trie node. Leaves hold values, every other node holds children.
+   */
+  struct Node
+  {
+    std::vector<NodePtr> children;
+    std::vector<T> values;
+  };
+
+public:
+
+  typedef T value_type;
+
+  /**
+   * Iterates over the values of a vector in order.
+   */
+  class const_iterator
+  {
+  public:
+
+    typedef std::forward_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    const_iterator(const PersistentVector* vector, size_t index)
+      : mVector(vector)
+      , mIndex(index)
+      {
+      }
+
+    reference operator * () const { return (*mVector)[mIndex]; }
+    pointer operator -> () const { return &(*mVector)[mIndex]; }
+
+    const_iterator& operator ++ () { mIndex++; return *this; }
+    const_iterator operator ++ (int) { const_iterator result(*this); mIndex++; return result; }
+
+    bool operator == (const const_iterator& other) const { return mIndex == other.mIndex; }
+    bool operator != (const const_iterator& other) const { return mIndex != other.mIndex; }
+
+  private:
+
+    const PersistentVector* mVector;
+    size_t mIndex;
+  };
+
+  /**
+   * Constructs an empty vector.
+   */
+  PersistentVector()
+    : mSize(0)
+    , mShift(Bits)
+    , mRoot(std::make_shared<const Node>())
+    , mTail(std::make_shared<const Node>())
+    {
+    }
+
+  /**
+   * Constructs a vector holding the given values.
+   *
+   * @param values The initial values.
+   */
+  PersistentVector(std::initializer_list<T> values)
+    : PersistentVector()
+    {
+      for (const T& value : values)
+      {
+        *this = PushBack(value);
+      }
+    }
+
+  /**
+   * @return The number of values.
+   */
+  size_t Size() const
+  {
+    return mSize;
+  }
+
+  /**
+   * @return `true` if the vector has no values else `false`.
+   */
+  bool Empty() const
+  {
+    return mSize == 0;
+  }
+
+  /**
+   * Obtain the value at the given index without bounds checking.
+   *
+   * @param index The index of the value.
+   *
+   * @return The value.
+   */
+  const T& operator [] (size_t index) const
+  {
+    return leafFor(index).values[index & Mask];
+  }
+
+  /**
+   * Obtain the value at the given index.
+   *
+   * @param index The index of the value.
+   *
+   * @return The value.
+   *
+   * @throws std::out_of_range if the index is not less than Size().
+   */
+  const T& At(size_t index) const
+  {
+    if (index >= mSize)
+    {
+      throw std::out_of_range("PersistentVector index out of range");
+    }
+
+    return (*this)[index];
+  }
+
+  /**
+   * @return A vector with the given value appended.
+   */
+  PersistentVector PushBack(T value) const
+  {
+    PersistentVector result(*this);
+
+    if (mSize - tailOffset() < Width)
+    {
+      auto tail = std::make_shared<Node>(*mTail);
+      tail->values.push_back(std::move(value));
+      result.mTail = std::move(tail);
+    }
+    else
+    {
+      // the tail is full, move it into the trie
+      if ((mSize >> Bits) > (size_t(1) << mShift))
+      {
+        auto root = std::make_shared<Node>();
+        root->children.push_back(mRoot);
+        root->children.push_back(newPath(mShift, mTail));
+        result.mRoot = std::move(root);
+        result.mShift = mShift + Bits;
+      }
+      else
+      {
+        result.mRoot = pushTail(mShift, mRoot, mTail);
+      }
+
+      auto tail = std::make_shared<Node>();
+      tail->values.push_back(std::move(value));
+      result.mTail = std::move(tail);
+    }
+
+    result.mSize = mSize + 1;
+    return result;
+  }
+
+  /**
+   * @return A vector with the value at the given index replaced.
+   *
+   * @throws std::out_of_range if the index is not less than Size().
+   */
+  PersistentVector Set(size_t index, T value) const
+  {
+    if (index >= mSize)
+    {
+      throw std::out_of_range("PersistentVector index out of range");
+    }
+
+    PersistentVector result(*this);
+
+    if (index >= tailOffset())
+    {
+      auto tail = std::make_shared<Node>(*mTail);
+      tail->values[index & Mask] = std::move(value);
+      result.mTail = std::move(tail);
+    }
+    else
+    {
+      result.mRoot = assoc(mShift, mRoot, index, std::move(value));
+    }
+
+    return result;
+  }
+
+  /**
+   * @return A vector with the last value removed.
+   *
+   * @throws std::out_of_range if the vector is empty.
+   */
+  PersistentVector PopBack() const
+  {
+    if (mSize == 0)
+    {
+      throw std::out_of_range("PopBack() on an empty PersistentVector");
+    }
+
+    if (mSize == 1)
+    {
+      return PersistentVector();
+    }
+
+    PersistentVector result(*this);
+    result.mSize = mSize - 1;
+
+    if (mSize - tailOffset() > 1)
+    {
+      auto tail = std::make_shared<Node>(*mTail);
+      tail->values.pop_back();
+      result.mTail = std::move(tail);
+      return result;
+    }
+
+    // the tail is empty now, the last leaf of the trie becomes the tail
+    result.mTail = leafNodeFor(mSize - 2);
+
+    NodePtr root = popTail(mShift, mRoot);
+
+    if (!root)
+    {
+      root = std::make_shared<const Node>();
+    }
+
+    if (mShift > Bits && root->children.size() == 1)
+    {
+      result.mRoot = root->children[0];
+      result.mShift = mShift - Bits;
+    }
+    else
+    {
+      result.mRoot = std::move(root);
+    }
+
+    return result;
+  }
+
+  const_iterator begin() const
+  {
+    return const_iterator(this, 0);
+  }
+
+  const_iterator end() const
+  {
+    return const_iterator(this, mSize);
+  }
+
+  /**
+   * Compares two vectors value by value, skipping the comparison entirely
+   * when both share the same trie and tail.
+   */
+  bool operator == (const PersistentVector& other) const
+  {
+    if (mSize != other.mSize)
+    {
+      return false;
+    }
+
+    if (mRoot == other.mRoot && mTail == other.mTail)
+    {
+      return true;
+    }
+
+    for (size_t i = 0; i < mSize; i++)
+    {
+      if (!((*this)[i] == other[i]))
+      {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  bool operator != (const PersistentVector& other) const
+  {
+    return !(*this == other);
+  }
+
+private:
+
+  size_t tailOffset() const
+  {
+    return mSize < Width ? 0 : ((mSize - 1) >> Bits) << Bits;
+  }
+
+  const Node& leafFor(size_t index) const
+  {
+    return *leafNodeFor(index);
+  }
+
+  NodePtr leafNodeFor(size_t index) const
+  {
+    if (index >= tailOffset())
+    {
+      return mTail;
+    }
+
+    const NodePtr* node = &mRoot;
+
+    for (unsigned level = mShift; level > 0; level -= Bits)
+    {
+      node = &(*node)->children[(index >> level) & Mask];
+    }
+
+    return *node;
+  }
+
+  static NodePtr newPath(unsigned level, const NodePtr& node)
+  {
+    if (level == 0)
+    {
+      return node;
+    }
+
+    auto path = std::make_shared<Node>();
+    path->children.push_back(newPath(level - Bits, node));
+    return path;
+  }
+
+  NodePtr pushTail(unsigned level, const NodePtr& parent, const NodePtr& tail) const
+  {
+    size_t index = ((mSize - 1) >> level) & Mask;
+    auto node = std::make_shared<Node>(*parent);
+    NodePtr child;
+
+    if (level == Bits)
+    {
+      child = tail;
+    }
+    else if (index < parent->children.size())
+    {
+      child = pushTail(level - Bits, parent->children[index], tail);
+    }
+    else
+    {
+      child = newPath(level - Bits, tail);
+    }
+
+    if (index < node->children.size())
+    {
+      node->children[index] = std::move(child);
+    }
+    else
+    {
+      node->children.push_back(std::move(child));
+    }
+
+    return node;
+  }
+
+  static NodePtr assoc(unsigned level, const NodePtr& parent, size_t index, T value)
+  {
+    auto node = std::make_shared<Node>(*parent);
+
+    if (level == 0)
+    {
+      node->values[index & Mask] = std::move(value);
+    }
+    else
+    {
+      size_t child = (index >> level) & Mask;
+      node->children[child] = assoc(level - Bits, parent->children[child], index, std::move(value));
+    }
+
+    return node;
+  }
+
+  /**
+   * Removes the last leaf from the trie. Returns nothing when the node
+   * becomes empty.
+   */
+  NodePtr popTail(unsigned level, const NodePtr& parent) const
+  {
+    size_t index = ((mSize - 2) >> level) & Mask;
+
+    if (level > Bits)
+    {
+      NodePtr child = popTail(level - Bits, parent->children[index]);
+
+      if (!child && index == 0)
+      {
+        return NodePtr();
+      }
+
+      auto node = std::make_shared<Node>(*parent);
+
+      if (child)
+      {
+        node->children[index] = std::move(child);
+      }
+      else
+      {
+        node->children.pop_back();
+      }
+
+      return node;
+    }
+    else if (index == 0)
+    {
+      return NodePtr();
+    }
+    else
+    {
+      auto node = std::make_shared<Node>(*parent);
+      node->children.pop_back();
+      return node;
+    }
+  }
+
+  size_t mSize;
+  unsigned mShift;
+  NodePtr mRoot;
+  NodePtr mTail;
+};
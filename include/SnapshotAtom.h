@@ -0,0 +1,412 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <Atom.h>
+
+/**
+ * A SnapshotAtom is an Atom for large values (maps, vectors, big structs)
+ * which holds its state as an immutable, reference counted snapshot.
+ *
+ * Reading never copies the value. Value() returns a cheap handle to the
+ * current snapshot which remains valid, and unchanged, for as long as the
+ * caller holds it, no matter how many times the atom is updated in the
+ * meantime. Old snapshots are reclaimed automatically once the last reader
+ * releases its handle.
+ *
+ * Writers build the new value entirely outside of any critical section and
+ * publish it with a single compare-and-swap of the snapshot pointer. There
+ * is no write lock which readers could be blocked on while a value is being
+ * built.
+ *
+ * @note Loading and swapping a `std::shared_ptr` atomically is not lock-free
+ *       on common standard libraries. With C++20 the snapshot is held in a
+ *       `std::atomic<std::shared_ptr>`, which libstdc++ guards with a lock
+ *       bit inside the atom. Before C++20 the free `std::atomic_load()`
+ *       family is used, which libstdc++ guards with a global pool of mutexes
+ *       shared by all atoms. Either way the lock only covers the pointer and
+ *       its reference count, never the value or an update function.
+ *
+ * @note Because there is no lock which can be held while the update function
+ *       runs, Reset(UpdateFunc) is implemented as a compare-and-swap loop just
+ *       like Swap(). The update function may be called more than once and
+ *       must be free of side effects.
+ *
+ * @see Atom
+ */
+template<typename T>
+class SnapshotAtom
+{
+public:
+
+  /**
+   * A shared, immutable handle to one version of the value.
+   */
+  typedef std::shared_ptr<const T> Snapshot;
+
+  /**
+   * A function used to calculate the new value based on the current value.
+   *
+   * @param currentValue The current value.
+   *
+   * @return The new value which will be validated and possibly saved.
+   */
+  typedef std::function<T(const T& currentValue)> UpdateFunc;
+
+  /**
+   * A function for validating the new value.
+   *
+   * @param newValue The new value.
+   *
+   * @return `true` if the new value is valid else `false`.
+   **/
+  typedef std::function<bool(const T& newValue)> ValidateFunc;
+
+  /**
+   * A function for comparing the current value.
+   *
+   * @param currentValue The current value.
+   *
+   * @return `true` if the comparison is successful else `false`.
+   **/
+  typedef std::function<bool(const T& currentValue)> ComparatorFunc;
+
+  /**
+   * A function for working with the current value without modifying it.
+   *
+   * @param currentValue The current value.
+   **/
+  typedef std::function<void(const T& currentValue)> WithFunc;
+
+  /**
+   * A function for modifying a private copy of the current value.
+   *
+   * @param currentValue The copy of the current value.
+   **/
+  typedef std::function<void(T& currentValue)> ModifyFunc;
+
+  /**
+   * Constructs a new SnapshotAtom with the given initial value and optional
+   * validation function.
+   *
+   * @param initialValue The initial value.
+   * @param validator Function to be used when validating a new value.
+   */
+  explicit SnapshotAtom(const T& initialValue, ValidateFunc validator = [](const T&){ return true; })
+    : mSnapshot(std::make_shared<const T>(initialValue))
+    , mValidator(validator)
+    {
+    }
+
+  virtual ~SnapshotAtom() {  }
+
+  /**
+   * Atomically overwrite the current value with the new value.
+   *
+   * @note Does not perform validation of the new value.
+   *
+   * @param newValue The intended new value.
+   */
+  void operator = (const T& newValue)
+  {
+    publish(std::make_shared<const T>(newValue));
+  }
+
+  /**
+   * Atomically compare the current value to the given value.
+   *
+   * @param otherValue The value to compare against.
+   *
+   * @return `true` if the values are equal else `false`.
+   */
+  bool operator == (const T& otherValue)
+  {
+    return *Value() == otherValue;
+  }
+
+  /**
+   * Atomically compare the current value to the given value.
+   *
+   * @param otherValue The value to compare against.
+   *
+   * @return `true` if the value are not equal else `false`.
+   */
+  bool operator != (const T& otherValue)
+  {
+    return *Value() != otherValue;
+  }
+
+  /**
+   * Atomically obtain a handle to the current snapshot. The value is not
+   * copied.
+   *
+   * @return The current snapshot.
+   */
+  Snapshot Value()
+  {
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return mSnapshot.load(std::memory_order_acquire);
+#else
+    return std::atomic_load_explicit(&mSnapshot, std::memory_order_acquire);
+#endif
+  }
+
+  /**
+   * Atomically compares the current value using the given block.
+   *
+   * @param func The lambda used to evaluate the current value.
+   *
+   * @return `true` if the comparison is successful else `false`.
+   */
+  template<typename F>
+  bool Compare(F&& func)
+  {
+    return func(*Value());
+  }
+
+  /**
+   * Atomically replaces the current snapshot with the new value if and only
+   * if the current snapshot is the one given and the new value successfully
+   * validates against the (optional) validator given at construction.
+   *
+   * The check is a pointer comparison, so it costs the same no matter how
+   * large the value is.
+   *
+   * @param oldSnapshot The expected current snapshot.
+   * @param newValue The intended new value.
+   *
+   * @return `true` if the value is changed else `false`.
+   */
+  bool CompareAndSet(const Snapshot& oldSnapshot, const T& newValue)
+  {
+    if (!isValid(newValue))
+    {
+      return false;
+    }
+
+    Snapshot expected = oldSnapshot;
+    return compareAndPublish(expected, std::make_shared<const T>(newValue));
+  }
+
+  /**
+   * Atomically sets the value of atom to the new value without regard for the
+   * current value so long as the new value successfully validates against the
+   * (optional) validator given at construction.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The current snapshot after all operations and validations are
+   *         complete.
+   */
+  Snapshot Reset(const T& newValue)
+  {
+    if (!isValid(newValue))
+    {
+      return Value();
+    }
+
+    Snapshot snapshot = std::make_shared<const T>(newValue);
+    publish(snapshot);
+    return snapshot;
+  }
+
+  /**
+   * Atomically sets the value of atom using the given block. If validation
+   * fails the value will not be changed.
+   *
+   * @note The update function may be called more than once and must be free
+   *       of side effects.
+   *
+   * @param func The lambda used to calculate the new value.
+   *
+   * @return The current snapshot after the update has occurred (or been
+   *         rejected as invalid).
+   */
+  template<typename F, typename = EnableIfUpdateFunc<F, T>>
+  Snapshot Reset(F&& func)
+  {
+    Snapshot oldSnapshot = Value();
+
+    for (;;)
+    {
+      T newValue = func(*oldSnapshot);
+
+      if (!isValid(newValue))
+      {
+        return oldSnapshot;
+      }
+
+      Snapshot newSnapshot = std::make_shared<const T>(std::move(newValue));
+
+      if (compareAndPublish(oldSnapshot, newSnapshot))
+      {
+        return newSnapshot;
+      }
+    }
+  }
+
+  /**
+   * Atomically sets the value of atom using the given block. The block is
+   * called with the current snapshot, outside of any critical section, and
+   * the result is published with a single pointer compare-and-swap. If
+   * another thread published a new snapshot in the meantime the loop retries
+   * against it.
+   *
+   * @note If the new value fails validation the attempt counts as failed and
+   *       the loop retries, exactly like Atom::Swap().
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current snapshot after the update has occurred (or been
+   *         rejected as invalid).
+   */
+  template<typename F>
+  Snapshot Swap(F&& func, int maxAttempts = 0)
+  {
+    return Swap(func, NoBackoff(), maxAttempts);
+  }
+
+  /**
+   * Works exactly like Swap() but calls the given backoff strategy after
+   * every failed attempt. See Backoff.h.
+   *
+   * @param func The lambda used to calculate the new value.
+   * @param backoff The strategy called with the number of attempts made so
+   *        far after every failed attempt.
+   * @param maxAttempts The maximum number of times the spin loop may run
+   *        before rejecting the update.
+   *
+   * @return The current snapshot after the update has occurred (or been
+   *         rejected as invalid).
+   */
+  template<typename F, typename Backoff, typename = EnableIfBackoff<Backoff>>
+  Snapshot Swap(F&& func, Backoff backoff, int maxAttempts = 0)
+  {
+    Snapshot oldSnapshot = Value();
+    int attempts{ 0 };
+
+    for (;;)
+    {
+      T newValue = func(*oldSnapshot);
+      attempts++;
+
+      if (isValid(newValue))
+      {
+        Snapshot newSnapshot = std::make_shared<const T>(std::move(newValue));
+
+        if (compareAndPublish(oldSnapshot, newSnapshot))
+        {
+          return newSnapshot;
+        }
+      }
+      else
+      {
+        oldSnapshot = Value();
+      }
+
+      if (maxAttempts > 0 && attempts >= maxAttempts)
+      {
+        return oldSnapshot;
+      }
+
+      backoff(attempts);
+    }
+  }
+
+  /**
+   * Calls the lambda with the current snapshot. The snapshot cannot change
+   * while the lambda runs and writers are never blocked by it.
+   *
+   * @param func The lambda used to operate with the current value.
+   */
+  template<typename F>
+  void With(F&& func)
+  {
+    Snapshot snapshot = Value();
+    func(*snapshot);
+  }
+
+  /**
+   * Calls the lambda with a mutable copy of the current value and publishes
+   * the result, retrying if another snapshot was published in the meantime.
+   *
+   * @note Does not perform validation of the new value.
+   * @note The lambda may be called more than once.
+   *
+   * @param func The lambda used to modify the copy of the current value.
+   *
+   * @return The snapshot published by this call.
+   */
+  template<typename F>
+  Snapshot Modify(F&& func)
+  {
+    Snapshot oldSnapshot = Value();
+
+    for (;;)
+    {
+      auto newValue = std::make_shared<T>(*oldSnapshot);
+      func(*newValue);
+
+      Snapshot newSnapshot = std::move(newValue);
+
+      if (compareAndPublish(oldSnapshot, newSnapshot))
+      {
+        return newSnapshot;
+      }
+    }
+  }
+
+protected:
+
+  /**
+   * Validates the new value against the validator function.
+   *
+   * @param newValue The value to be validated.
+   *
+   * @return `true` is the new value is valid else `false`.
+   */
+  bool isValid(const T& newValue)
+  {
+    return mValidator(newValue);
+  }
+
+private:
+
+  void publish(const Snapshot& snapshot)
+  {
+#if defined(__cpp_lib_atomic_shared_ptr)
+    mSnapshot.store(snapshot, std::memory_order_release);
+#else
+    std::atomic_store_explicit(&mSnapshot, snapshot, std::memory_order_release);
+#endif
+  }
+
+  /**
+   * Publishes the new snapshot if the current one is `expected`. On failure
+   * `expected` is updated to the current snapshot.
+   */
+  bool compareAndPublish(Snapshot& expected, const Snapshot& desired)
+  {
+#if defined(__cpp_lib_atomic_shared_ptr)
+    return mSnapshot.compare_exchange_strong(expected, desired,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire);
+#else
+    return std::atomic_compare_exchange_strong_explicit(
+      &mSnapshot, &expected, desired,
+      std::memory_order_acq_rel, std::memory_order_acquire);
+#endif
+  }
+
+#if defined(__cpp_lib_atomic_shared_ptr)
+  std::atomic<Snapshot> mSnapshot;
+#else
+  Snapshot mSnapshot;
+#endif
+
+  ValidateFunc mValidator;
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+#include <LockPolicy.h>
+
+/**
+ * A StripedAtom is a numeric value optimized for many threads updating it
+ * at the same time, such as hit counters and accumulated totals. It is the
+ * equivalent of Java's `LongAdder`.
+ *
+ * An Atom keeps its value in one place, so every update from every thread
+ * lands on the same cache line and the line bounces between cores. A
+ * StripedAtom instead spreads the value over several cells, each on its own
+ * cache line. Every thread adds to the cell assigned to it and the cells are
+ * summed when the value is read. Updates therefore scale with the number of
+ * cores at the price of a slower, wider read.
+ *
+ * Because the value is split into parts the only updates which can be
+ * spread out are additions. An arbitrary update function as taken by
+ * Atom::Swap() cannot be applied to a part, so the write surface consists of
+ * Add(), Increment(), and Decrement() instead.
+ *
+ * @note Value() is not an atomic snapshot. When updates happen concurrently
+ *       with the read, the result includes some of them and not others. Once
+ *       updates have stopped the result is exact.
+ *
+ * @see Atom
+ */
+template<typename T>
+class StripedAtom
+{
+  static_assert(std::is_arithmetic<T>::value,
+                "StripedAtom requires an arithmetic value type");
+
+public:
+
+  /**
+   * Constructs a new StripedAtom with the given initial value.
+   *
+   * @param initialValue The initial value.
+   * @param stripes The number of cells to spread updates over. Rounded up to
+   *        a power of two. Defaults to twice the number of hardware threads.
+   */
+  explicit StripedAtom(T initialValue = T(), size_t stripes = DefaultStripes())
+    : mMask(roundUp(stripes) - 1)
+    , mCells(new Cell[mMask + 1])
+    {
+      mCells[0].value.store(initialValue, std::memory_order_relaxed);
+    }
+
+  StripedAtom(const StripedAtom&) = delete;
+  StripedAtom& operator = (const StripedAtom&) = delete;
+
+  virtual ~StripedAtom() {  }
+
+  /**
+   * Overwrite the current value with the new value.
+   *
+   * @note Additions made concurrently with this call may or may not be
+   *       reflected in the result.
+   *
+   * @param newValue The intended new value.
+   */
+  void operator = (const T& newValue)
+  {
+    Reset(newValue);
+  }
+
+  /**
+   * Add the given amount to the value.
+   *
+   * @param delta The amount to add.
+   */
+  void operator += (const T& delta)
+  {
+    Add(delta);
+  }
+
+  /**
+   * Subtract the given amount from the value.
+   *
+   * @param delta The amount to subtract.
+   */
+  void operator -= (const T& delta)
+  {
+    Add(-delta);
+  }
+
+  /**
+   * Obtain the current value by summing all cells.
+   *
+   * @return The current value.
+   */
+  T Value() const
+  {
+    T sum{};
+
+    for (size_t i = 0; i <= mMask; i++)
+    {
+      sum += mCells[i].value.load(std::memory_order_relaxed);
+    }
+
+    return sum;
+  }
+
+  /**
+   * Add the given amount to the cell of the calling thread.
+   *
+   * @param delta The amount to add.
+   */
+  void Add(const T& delta)
+  {
+    add(mCells[ThreadStripe() & mMask].value, delta);
+  }
+
+  /**
+   * Add one to the value.
+   */
+  void Increment()
+  {
+    Add(T(1));
+  }
+
+  /**
+   * Subtract one from the value.
+   */
+  void Decrement()
+  {
+    Add(T(-1));
+  }
+
+  /**
+   * Overwrite the current value with the new value.
+   *
+   * @note Additions made concurrently with this call may or may not be
+   *       reflected in the result.
+   *
+   * @param newValue The intended new value.
+   *
+   * @return The new value.
+   */
+  T Reset(const T& newValue)
+  {
+    for (size_t i = 1; i <= mMask; i++)
+    {
+      mCells[i].value.store(T(), std::memory_order_relaxed);
+    }
+
+    mCells[0].value.store(newValue, std::memory_order_relaxed);
+
+    return newValue;
+  }
+
+  /**
+   * Obtain the current value and set it back to zero in one pass. Every
+   * addition is counted exactly once across successive calls, which makes
+   * this the way to drain a counter periodically.
+   *
+   * @return The value before it was reset.
+   */
+  T SumThenReset()
+  {
+    T sum{};
+
+    for (size_t i = 0; i <= mMask; i++)
+    {
+      sum += mCells[i].value.exchange(T(), std::memory_order_relaxed);
+    }
+
+    return sum;
+  }
+
+  /**
+   * The number of cells updates are spread over.
+   */
+  size_t Stripes() const
+  {
+    return mMask + 1;
+  }
+
+  /**
+   * The default number of cells: twice the number of hardware threads.
+   */
+  static size_t DefaultStripes()
+  {
+    size_t cores = std::thread::hardware_concurrency();
+    return cores > 0 ? cores * 2 : 8;
+  }
+
+  /**
+   * A small number unique to the calling thread, assigned round-robin the
+   * first time the thread updates any StripedAtom.
+   */
+  static size_t ThreadStripe()
+  {
+    static std::atomic<size_t> next{ 0 };
+    static thread_local size_t stripe = next.fetch_add(1, std::memory_order_relaxed);
+    return stripe;
+  }
+
+private:
+
+  struct alignas(CacheLineSize) Cell
+  {
+    std::atomic<T> value{ T() };
+  };
+
+  template<typename U = T>
+  static typename std::enable_if<std::is_integral<U>::value>::type
+  add(std::atomic<U>& cell, const U& delta)
+  {
+    cell.fetch_add(delta, std::memory_order_relaxed);
+  }
+
+  template<typename U = T>
+  static typename std::enable_if<!std::is_integral<U>::value>::type
+  add(std::atomic<U>& cell, const U& delta)
+  {
+    U current = cell.load(std::memory_order_relaxed);
+
+    while (!cell.compare_exchange_weak(current, current + delta,
+                                       std::memory_order_relaxed))
+    {
+    }
+  }
+
+  static size_t roundUp(size_t stripes)
+  {
+    size_t result = 1;
+
+    while (result < stripes)
+    {
+      result *= 2;
+    }
+
+    return result;
+  }
+
+  const size_t mMask;
+
+  std::unique_ptr<Cell[]> mCells;
+};
+
+/**
+ * A StripedAtom used as a counter.
+ */
+template<typename T = uint64_t>
+using Adder = StripedAtom<T>;
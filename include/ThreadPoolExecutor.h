@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <Executor.h>
+#include <LockPolicy.h>
+#include <WorkStealingDeque.h>
+
+/**
+ * Runs tasks on a fixed number of worker threads which balance the load
+ * among themselves by stealing work.
+ *
+ * Every worker owns a WorkStealingDeque. A task submitted by a worker, e.g.
+ * the continuation of the task it is running, goes onto that worker's own
+ * deque without any locking; tasks submitted from other threads go onto a
+ * shared injection queue. A worker runs the newest task of its own deque
+ * first, then the oldest task of the injection queue, and finally tries to
+ * steal the oldest task of another worker's deque.
+ *
+ * A worker which finds nothing to do parks on a condition variable.
+ * Submitting a task wakes a single parked worker, and only pays for the
+ * wakeup when some worker is actually parked.
+ *
+ * Tasks submitted by one thread may run in any order and concurrently. The
+ * destructor runs every task already submitted, including those they
+ * submit in turn, and then joins the workers. As with `std::thread`, an
+ * exception escaping a task terminates the program.
+ *
+ * @see SharedExecutor()
+ */
+class ThreadPoolExecutor : public Executor
+{
+public:
+
+  /**
+   * Starts the workers.
+   *
+   * @param workerCount The number of worker threads, at least one.
+   */
+  explicit ThreadPoolExecutor(size_t workerCount = DefaultWorkerCount())
+  {
+    workerCount = std::max<size_t>(workerCount, 1);
+
+    for (size_t i = 0; i < workerCount; i++)
+    {
+      mWorkers.emplace_back(new Worker());
+    }
+
+    for (size_t i = 0; i < workerCount; i++)
+    {
+      mWorkers[i]->thread = std::thread([this, i]() { run(i); });
+    }
+  }
+
+  ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+  ThreadPoolExecutor& operator = (const ThreadPoolExecutor&) = delete;
+
+  ~ThreadPoolExecutor()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mParkingMutex);
+      mStopping = true;
+      mSignals++;
+    }
+
+    mParking.notify_all();
+
+    for (std::unique_ptr<Worker>& worker : mWorkers)
+    {
+      worker->thread.join();
+    }
+  }
+
+  void Execute(Task task) override
+  {
+    Task* item = new Task(std::move(task));
+    Context& context = current();
+
+    if (context.pool == this)
+    {
+      mWorkers[context.index]->deque.Push(item);
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lock(mInjectionMutex);
+      mInjection.push_back(item);
+      mInjectionSize.store(mInjection.size(), std::memory_order_relaxed);
+    }
+
+    wakeOne();
+  }
+
+  /**
+   * @return The number of worker threads.
+   */
+  size_t WorkerCount() const
+  {
+    return mWorkers.size();
+  }
+
+  /**
+   * @return One worker per hardware thread.
+   */
+  static size_t DefaultWorkerCount()
+  {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+private:
+
+  struct alignas(CacheLineSize) Worker
+  {
+    WorkStealingDeque<Task*> deque;
+    std::thread thread;
+  };
+
+  /**
+   * Which pool, if any, the calling thread works for.
+   */
+  struct Context
+  {
+    ThreadPoolExecutor* pool{ nullptr };
+    size_t index{ 0 };
+  };
+
+  static Context& current()
+  {
+    thread_local Context context;
+    return context;
+  }
+
+  void run(size_t index)
+  {
+    current() = Context{ this, index };
+
+    uint32_t random = static_cast<uint32_t>(index + 1) * 2654435761u;
+
+    for (;;)
+    {
+      Task* item = findTask(index, random);
+
+      if (item != nullptr)
+      {
+        std::unique_ptr<Task> task(item);
+        (*task)();
+        continue;
+      }
+
+      if (!park())
+      {
+        return;
+      }
+    }
+  }
+
+  /**
+   * Looks for a task in the worker's own deque, then the injection queue,
+   * then the deques of the other workers, starting at a random one.
+   */
+  Task* findTask(size_t index, uint32_t& random)
+  {
+    Task* item{ nullptr };
+
+    if (mWorkers[index]->deque.Pop(item))
+    {
+      return item;
+    }
+
+    if (mInjectionSize.load(std::memory_order_relaxed) != 0)
+    {
+      std::lock_guard<std::mutex> lock(mInjectionMutex);
+
+      if (!mInjection.empty())
+      {
+        item = mInjection.front();
+        mInjection.pop_front();
+        mInjectionSize.store(mInjection.size(), std::memory_order_relaxed);
+        return item;
+      }
+    }
+
+    const size_t count = mWorkers.size();
+
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+
+    for (size_t i = 0; i < count; i++)
+    {
+      size_t victim = (random + i) % count;
+
+      if (victim != index && mWorkers[victim]->deque.Steal(item))
+      {
+        return item;
+      }
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * @return `true` if any queue appeared to hold a task.
+   */
+  bool hasWork() const
+  {
+    if (mInjectionSize.load(std::memory_order_seq_cst) != 0)
+    {
+      return true;
+    }
+
+    for (const std::unique_ptr<Worker>& worker : mWorkers)
+    {
+      if (!worker->deque.Empty())
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Parks the worker until a task is submitted.
+   *
+   * The worker announces itself as a sleeper before checking the queues
+   * one last time, and submitters check for sleepers after queueing, so
+   * either the worker sees the task or the submitter sees the worker.
+   *
+   * Once the pool is stopping, the last worker to park while every queue
+   * is empty ends the pool: with every worker parked, no task is running
+   * which could submit another.
+   *
+   * @return `false` if the worker should exit.
+   */
+  bool park()
+  {
+    uint64_t signals;
+
+    {
+      std::lock_guard<std::mutex> lock(mParkingMutex);
+      signals = mSignals;
+    }
+
+    mSleepers.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (hasWork())
+    {
+      mSleepers.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mParkingMutex);
+
+    if (mStopping && mSleepers.load(std::memory_order_seq_cst) == mWorkers.size())
+    {
+      mDone = true;
+      mParking.notify_all();
+    }
+
+    mParking.wait(lock, [&]() { return mDone || mSignals != signals; });
+
+    if (mDone)
+    {
+      return false;
+    }
+
+    mSleepers.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  void wakeOne()
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (mSleepers.load(std::memory_order_relaxed) != 0)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mParkingMutex);
+        mSignals++;
+      }
+
+      mParking.notify_one();
+    }
+  }
+
+  std::vector<std::unique_ptr<Worker>> mWorkers;
+
+  std::mutex mInjectionMutex;
+
+  std::deque<Task*> mInjection;
+
+  std::atomic<size_t> mInjectionSize{ 0 };
+
+  std::mutex mParkingMutex;
+
+  std::condition_variable mParking;
+
+  uint64_t mSignals{ 0 };
+
+  std::atomic<size_t> mSleepers{ 0 };
+
+  bool mStopping{ false };
+
+  bool mDone{ false };
+};
+
+/**
+ * @return The executor asynchronous features use unless they are given a
+ *         different one: a ThreadPoolExecutor with one worker per hardware
+ *         thread, started on first use.
+ */
+inline Executor& SharedExecutor()
+{
+  static ThreadPoolExecutor executor;
+  return executor;
+}
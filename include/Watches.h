@@ -0,0 +1,381 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Executor.h>
+
+/**
+ * How a watcher is told about changes.
+ */
+enum class WatchMode
+{
+  /**
+   * The watcher is called once for every change.
+   */
+  EveryChange,
+
+  /**
+   * Changes made while the watcher still has a call pending or running are
+   * merged into a single call, from the oldest value not yet reported to
+   * the newest value. A slow watcher is therefore called less often rather
+   * than falling further and further behind. A change which reaches the
+   * watcher only after a newer one has been reported is dropped.
+   */
+  Coalesce
+};
+
+/**
+ * The watchers registered with one Atom. See Atom::AddWatch().
+ *
+ * The table of watchers is allocated on the first call to Add(), so an atom
+ * nobody watches pays for a single pointer. Writers take a snapshot of the
+ * table without locking; Add() and Remove() copy it.
+ *
+ * @tparam T The type of the watched value.
+ */
+template<typename T>
+class Watches
+{
+public:
+
+  /**
+   * A function told about a change of the watched value.
+   *
+   * @param oldValue The value before the change.
+   * @param newValue The value after the change.
+   */
+  typedef std::function<void(const T& oldValue, const T& newValue)> WatchFunc;
+
+  Watches() {  }
+
+  Watches(const Watches&) = delete;
+  Watches& operator = (const Watches&) = delete;
+
+  ~Watches()
+  {
+    delete mRegistry.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return `true` if nobody is watching.
+   */
+  bool Empty() const
+  {
+    Registry* registry = mRegistry.load(std::memory_order_acquire);
+    return registry == nullptr || registry->count.load(std::memory_order_relaxed) == 0;
+  }
+
+  /**
+   * Adds a watcher, replacing any watcher with the same key.
+   *
+   * @param key Identifies the watcher.
+   * @param func Called with the old and new value.
+   * @param executor Where the watcher is called.
+   * @param mode Whether rapid changes are merged. See WatchMode.
+   */
+  void Add(const std::string& key, WatchFunc func, Executor& executor, WatchMode mode)
+  {
+    Registry& registry = getRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    auto watches = std::make_shared<WatchList>(registry.watches ? *registry.watches : WatchList());
+    auto watch = std::make_shared<Watch>(key, std::move(func), executor, mode);
+
+    auto existing = find(*watches, key);
+
+    if (existing != watches->end())
+    {
+      (*existing)->Cancel();
+      *existing = watch;
+    }
+    else
+    {
+      watches->push_back(watch);
+    }
+
+    publish(registry, watches);
+  }
+
+  /**
+   * Removes the watcher with the given key. Calls already running may
+   * still complete, but no further calls are made.
+   *
+   * @param key Identifies the watcher.
+   *
+   * @return `true` if there was such a watcher else `false`.
+   */
+  bool Remove(const std::string& key)
+  {
+    Registry* registry = mRegistry.load(std::memory_order_acquire);
+
+    if (registry == nullptr)
+    {
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registry->mutex);
+
+    if (!registry->watches)
+    {
+      return false;
+    }
+
+    auto watches = std::make_shared<WatchList>(*registry->watches);
+    auto existing = find(*watches, key);
+
+    if (existing == watches->end())
+    {
+      return false;
+    }
+
+    (*existing)->Cancel();
+    watches->erase(existing);
+
+    publish(*registry, watches);
+    return true;
+  }
+
+  /**
+   * Tells every watcher about a change.
+   *
+   * @param oldValue The value before the change.
+   * @param newValue The value after the change.
+   * @param version The version of the new value, used to order merged
+   *        changes.
+   */
+  void Notify(const T& oldValue, const T& newValue, uint64_t version)
+  {
+    Registry* registry = mRegistry.load(std::memory_order_acquire);
+
+    if (registry == nullptr)
+    {
+      return;
+    }
+
+    std::shared_ptr<const WatchList> watches = std::atomic_load(&registry->watches);
+
+    if (watches)
+    {
+      for (const std::shared_ptr<Watch>& watch : *watches)
+      {
+        watch->Notify(oldValue, newValue, version);
+      }
+    }
+  }
+
+private:
+
+  /**
+   * A single watcher and, in WatchMode::Coalesce, the change waiting to be
+   * reported to it.
+   */
+  class Watch : public std::enable_shared_from_this<Watch>
+  {
+  public:
+
+    Watch(const std::string& key, WatchFunc func, Executor& executor, WatchMode mode)
+      : mKey(key)
+      , mFunc(std::move(func))
+      , mExecutor(executor)
+      , mMode(mode)
+      {
+      }
+
+    const std::string& Key() const
+    {
+      return mKey;
+    }
+
+    void Cancel()
+    {
+      mCancelled.store(true, std::memory_order_release);
+    }
+
+    void Notify(const T& oldValue, const T& newValue, uint64_t version)
+    {
+      std::shared_ptr<Watch> self = this->shared_from_this();
+
+      if (mMode == WatchMode::EveryChange)
+      {
+        mExecutor.Execute([self, oldValue, newValue]()
+        {
+          if (!self->mCancelled.load(std::memory_order_acquire))
+          {
+            self->call(oldValue, newValue);
+          }
+        });
+
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // a writer which lost the race to a newer, already reported change
+        if (version <= mReportedLast)
+        {
+          return;
+        }
+
+        if (mPending)
+        {
+          // writers may get here out of order, the versions tell which end is which
+          if (version > mPendingLast)
+          {
+            mPending->second = newValue;
+            mPendingLast = version;
+          }
+
+          if (version < mPendingFirst)
+          {
+            mPending->first = oldValue;
+            mPendingFirst = version;
+          }
+        }
+        else
+        {
+          mPending.emplace(oldValue, newValue);
+          mPendingFirst = version;
+          mPendingLast = version;
+        }
+
+        if (mRunning)
+        {
+          return;
+        }
+
+        mRunning = true;
+      }
+
+      mExecutor.Execute([self]() { self->drain(); });
+    }
+
+  private:
+
+    /**
+     * Reports pending changes until there are none left.
+     */
+    void drain()
+    {
+      for (;;)
+      {
+        std::optional<std::pair<T, T>> change;
+
+        {
+          std::lock_guard<std::mutex> lock(mMutex);
+
+          if (!mPending)
+          {
+            mRunning = false;
+            return;
+          }
+
+          change.swap(mPending);
+          mReportedLast = mPendingLast;
+        }
+
+        if (mCancelled.load(std::memory_order_acquire))
+        {
+          continue;
+        }
+
+        call(change->first, change->second);
+      }
+    }
+
+    /**
+     * Calls the watcher. An exception it throws is dropped: it must neither
+     * reach the writer nor escape into an executor thread, where it would
+     * terminate the program.
+     */
+    void call(const T& oldValue, const T& newValue) noexcept
+    {
+      try
+      {
+        mFunc(oldValue, newValue);
+      }
+      catch (...)
+      {
+      }
+    }
+
+    const std::string mKey;
+
+    const WatchFunc mFunc;
+
+    Executor& mExecutor;
+
+    const WatchMode mMode;
+
+    std::atomic<bool> mCancelled{ false };
+
+    std::mutex mMutex;
+
+    bool mRunning{ false };
+
+    std::optional<std::pair<T, T>> mPending;
+
+    uint64_t mPendingFirst{ 0 };
+
+    uint64_t mPendingLast{ 0 };
+
+    uint64_t mReportedLast{ 0 };
+  };
+
+  typedef std::vector<std::shared_ptr<Watch>> WatchList;
+
+  struct Registry
+  {
+    std::mutex mutex;
+    std::atomic<size_t> count{ 0 };
+    std::shared_ptr<const WatchList> watches;
+  };
+
+  static typename WatchList::iterator find(WatchList& watches, const std::string& key)
+  {
+    return std::find_if(watches.begin(), watches.end(), [&](const std::shared_ptr<Watch>& watch)
+    {
+      return watch->Key() == key;
+    });
+  }
+
+  static void publish(Registry& registry, const std::shared_ptr<const WatchList>& watches)
+  {
+    std::atomic_store(&registry.watches, watches);
+    registry.count.store(watches->size(), std::memory_order_release);
+  }
+
+  Registry& getRegistry()
+  {
+    Registry* registry = mRegistry.load(std::memory_order_acquire);
+
+    if (registry != nullptr)
+    {
+      return *registry;
+    }
+
+    Registry* created = new Registry();
+
+    if (mRegistry.compare_exchange_strong(registry, created,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire))
+    {
+      return *created;
+    }
+
+    delete created;
+    return *registry;
+  }
+
+  std::atomic<Registry*> mRegistry{ nullptr };
+};
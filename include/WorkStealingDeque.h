@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <LockPolicy.h>
+
+/**
+ * A double-ended queue owned by one thread and robbed by the others, the
+ * building block of a work-stealing scheduler.
+ *
+ * The owner pushes and pops at the bottom, last in first out, which keeps
+ * recently created work hot in its cache. Any other thread may steal from
+ * the top, first in first out, taking the oldest and usually largest piece
+ * of work. The owner only synchronizes with thieves when the deque is
+ * almost empty. The buffer grows as needed; buffers which have been
+ * outgrown are kept until the deque is destroyed because a thief may still
+ * be reading from them.
+ *
+ * This is the deque of Chase and Lev with the memory orderings of Lê et al,
+ * except that Push() publishes with a release store rather than a release
+ * fence, which costs the same and is understood by ThreadSanitizer.
+ *
+ * @tparam T The type of the items, which must be trivially copyable, e.g. a
+ *         pointer.
+ *
+ * @see https://doi.org/10.1145/1073970.1073974
+ *      Dynamic Circular Work-Stealing Deque
+ * @see https://doi.org/10.1145/2442516.2442524
+ *      Correct and Efficient Work-Stealing for Weak Memory Models
+ */
+template<typename T>
+class WorkStealingDeque
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "WorkStealingDeque requires a trivially copyable item type");
+
+public:
+
+  /**
+   * @param capacity The initial capacity, rounded up to a power of two.
+   */
+  explicit WorkStealingDeque(size_t capacity = 64)
+  {
+    size_t size = 1;
+
+    while (size < capacity)
+    {
+      size <<= 1;
+    }
+
+    mBuffers.emplace_back(new Buffer(size));
+    mBuffer.store(mBuffers.back().get(), std::memory_order_relaxed);
+  }
+
+  WorkStealingDeque(const WorkStealingDeque&) = delete;
+  WorkStealingDeque& operator = (const WorkStealingDeque&) = delete;
+
+  /**
+   * Adds an item at the bottom. Only called by the owner.
+   *
+   * @param item The item.
+   */
+  void Push(T item)
+  {
+    int64_t bottom = mBottom.load(std::memory_order_relaxed);
+    int64_t top = mTop.load(std::memory_order_acquire);
+    Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+
+    if (bottom - top > static_cast<int64_t>(buffer->mask))
+    {
+      buffer = grow(buffer, top, bottom);
+    }
+
+    buffer->Put(bottom, item);
+    mBottom.store(bottom + 1, std::memory_order_release);
+  }
+
+  /**
+   * Takes the item at the bottom, the one pushed last. Only called by the
+   * owner.
+   *
+   * @param item Receives the item.
+   *
+   * @return `false` if the deque was empty else `true`.
+   */
+  bool Pop(T& item)
+  {
+    int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = mBuffer.load(std::memory_order_relaxed);
+    mBottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = mTop.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+      mBottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    item = buffer->Get(bottom);
+
+    if (top == bottom)
+    {
+      // the last item: race the thieves for it
+      bool won = mTop.compare_exchange_strong(top, top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      mBottom.store(bottom + 1, std::memory_order_relaxed);
+      return won;
+    }
+
+    return true;
+  }
+
+  /**
+   * Takes the item at the top, the one pushed first. May be called by any
+   * thread.
+   *
+   * @param item Receives the item.
+   *
+   * @return `false` if the deque was empty or another thread took the item
+   *         first else `true`.
+   */
+  bool Steal(T& item)
+  {
+    int64_t top = mTop.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = mBottom.load(std::memory_order_acquire);
+
+    if (top >= bottom)
+    {
+      return false;
+    }
+
+    Buffer* buffer = mBuffer.load(std::memory_order_acquire);
+    item = buffer->Get(top);
+
+    return mTop.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+  /**
+   * @return `true` if the deque appeared empty at the time of the call.
+   */
+  bool Empty() const
+  {
+    int64_t top = mTop.load(std::memory_order_seq_cst);
+    int64_t bottom = mBottom.load(std::memory_order_seq_cst);
+    return top >= bottom;
+  }
+
+private:
+
+  struct Buffer
+  {
+    explicit Buffer(size_t size)
+      : mask(size - 1)
+      , items(new std::atomic<T>[size])
+      {
+      }
+
+    T Get(int64_t index) const
+    {
+      return items[static_cast<size_t>(index) & mask].load(std::memory_order_relaxed);
+    }
+
+    void Put(int64_t index, T item)
+    {
+      items[static_cast<size_t>(index) & mask].store(item, std::memory_order_relaxed);
+    }
+
+    const size_t mask;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+
+  Buffer* grow(Buffer* buffer, int64_t top, int64_t bottom)
+  {
+    Buffer* bigger = new Buffer(2 * (buffer->mask + 1));
+    mBuffers.emplace_back(bigger);
+
+    for (int64_t i = top; i < bottom; i++)
+    {
+      bigger->Put(i, buffer->Get(i));
+    }
+
+    mBuffer.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  alignas(CacheLineSize) std::atomic<int64_t> mTop{ 0 };
+
+  alignas(CacheLineSize) std::atomic<int64_t> mBottom{ 0 };
+
+  std::atomic<Buffer*> mBuffer;
+
+  // owned by the owner thread, which is the only one to grow the deque
+  std::vector<std::unique_ptr<Buffer>> mBuffers;
+};
@@ -0,0 +1,378 @@
+#include <catch.hh>
+#include <Atom.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "Linearizability.h"
+
+namespace
+{
+  enum class Kind
+  {
+    Value,
+    Reset,
+    Swap,
+    Modify,
+    CompareAndSet,
+    Exchange,
+    ValueWithVersion,
+    CompareAndSetVersion
+  };
+
+  /**
+   * What a thread asked the atom to do.
+   */
+  struct Input
+  {
+    Kind kind;
+    int64_t first;
+    int64_t second;
+  };
+
+  /**
+   * What the atom returned. `success` is only meaningful for the compare
+   * and set operations and `version` only for the versioned ones.
+   */
+  struct Output
+  {
+    int64_t value;
+    uint64_t version;
+    bool success;
+  };
+
+  typedef Operation<Input, Output> AtomOperation;
+
+  struct RegisterState
+  {
+    int64_t value;
+    uint64_t version;
+
+    bool operator == (const RegisterState& other) const
+    {
+      return value == other.value && version == other.version;
+    }
+  };
+}
+
+namespace std
+{
+  template<>
+  struct hash<RegisterState>
+  {
+    size_t operator () (const RegisterState& state) const
+    {
+      return hash<int64_t>()(state.value) * 31 + hash<uint64_t>()(state.version);
+    }
+  };
+}
+
+namespace
+{
+  /**
+   * The sequential specification of an Atom holding an integer: a register
+   * whose version increases with every write.
+   */
+  struct RegisterModel
+  {
+    typedef RegisterState State;
+
+    State Init() const
+    {
+      return State{ 0, 0 };
+    }
+
+    bool Step(const State& state, const AtomOperation& op, State& next) const
+    {
+      const Input& in = op.input;
+      const Output& out = op.output;
+
+      next = state;
+
+      switch (in.kind)
+      {
+        case Kind::Value:
+          return out.value == state.value;
+
+        case Kind::Reset:
+          next = State{ in.first, state.version + 1 };
+          return out.value == in.first;
+
+        case Kind::Swap:
+        case Kind::Modify:
+          next = State{ state.value + in.first, state.version + 1 };
+          return out.value == next.value;
+
+        case Kind::Exchange:
+          next = State{ in.first, state.version + 1 };
+          return out.value == state.value;
+
+        case Kind::CompareAndSet:
+          if (state.value == in.first)
+          {
+            next = State{ in.second, state.version + 1 };
+          }
+          return out.success == (state.value == in.first);
+
+        case Kind::ValueWithVersion:
+          return out.value == state.value && out.version == state.version;
+
+        case Kind::CompareAndSetVersion:
+          if (state.version == static_cast<uint64_t>(in.first))
+          {
+            next = State{ in.second, state.version + 1 };
+          }
+          return out.success == (state.version == static_cast<uint64_t>(in.first));
+      }
+
+      return false;
+    }
+  };
+
+  /**
+   * Lets a thread perform one random operation against the atom, recording
+   * it in the history. Versioned operations are only used on atoms which
+   * keep a version.
+   */
+  template<bool Versioned, typename AtomType>
+  void randomOperation(AtomType& atom, History<Input, Output>& history,
+                       size_t thread, uint32_t random)
+  {
+    int64_t argument = static_cast<int64_t>(random >> 8) % 4;
+    int choices = Versioned ? 8 : 6;
+
+    switch (static_cast<Kind>(random % choices))
+    {
+      case Kind::Value:
+        history.Record(thread, Input{ Kind::Value, 0, 0 }, [&]()
+        {
+          return Output{ atom.Value(), 0, false };
+        });
+        break;
+
+      case Kind::Reset:
+        history.Record(thread, Input{ Kind::Reset, argument, 0 }, [&]()
+        {
+          return Output{ atom.Reset(argument), 0, false };
+        });
+        break;
+
+      case Kind::Swap:
+        history.Record(thread, Input{ Kind::Swap, argument, 0 }, [&]()
+        {
+          return Output{ atom.Swap([argument](const int64_t& value){ return value + argument; }), 0, false };
+        });
+        break;
+
+      case Kind::Modify:
+        history.Record(thread, Input{ Kind::Modify, argument, 0 }, [&]()
+        {
+          return Output{ atom.Modify([argument](int64_t& value){ value += argument; }), 0, false };
+        });
+        break;
+
+      case Kind::CompareAndSet:
+      {
+        int64_t expected = argument;
+        int64_t desired = static_cast<int64_t>(random >> 16) % 4;
+
+        history.Record(thread, Input{ Kind::CompareAndSet, expected, desired }, [&]()
+        {
+          return Output{ 0, 0, atom.CompareAndSet(expected, desired) };
+        });
+        break;
+      }
+
+      case Kind::Exchange:
+        history.Record(thread, Input{ Kind::Exchange, argument, 0 }, [&]()
+        {
+          return Output{ atom.Exchange(int64_t(argument)), 0, false };
+        });
+        break;
+
+      case Kind::ValueWithVersion:
+        if constexpr (Versioned)
+        {
+          history.Record(thread, Input{ Kind::ValueWithVersion, 0, 0 }, [&]()
+          {
+            std::pair<int64_t, uint64_t> current = atom.ValueWithVersion();
+            return Output{ current.first, current.second, false };
+          });
+        }
+        break;
+
+      case Kind::CompareAndSetVersion:
+        if constexpr (Versioned)
+        {
+          // half the time a version which is likely current, half a stale one
+          uint64_t version = atom.Version() - (random >> 24) % 2;
+          Input input{ Kind::CompareAndSetVersion, static_cast<int64_t>(version), argument };
+
+          history.Record(thread, input, [&]()
+          {
+            return Output{ 0, 0, atom.CompareAndSetVersion(version, argument) };
+          });
+        }
+        break;
+    }
+  }
+
+  /**
+   * Runs many short rounds of concurrent random operations against a fresh
+   * atom and checks every recorded history.
+   *
+   * @return The number of histories which were not linearizable.
+   */
+  template<typename AtomType, bool Versioned = true>
+  int countViolations()
+  {
+    const size_t threadCount = 4;
+    const int operationsPerThread = 25;
+    const int rounds = 200;
+
+    int violations{ 0 };
+
+    for (int round = 0; round < rounds; round++)
+    {
+      AtomType atom(0);
+      History<Input, Output> history(threadCount);
+      std::atomic<size_t> ready{ 0 };
+      std::vector<std::thread> threads;
+
+      for (size_t i = 0; i < threadCount; i++)
+      {
+        threads.emplace_back([&, i]()
+        {
+          uint32_t random = static_cast<uint32_t>((round * threadCount + i + 1) * 2654435761u);
+
+          ready.fetch_add(1);
+
+          while (ready.load() < threadCount)
+          {
+            std::this_thread::yield();
+          }
+
+          for (int j = 0; j < operationsPerThread; j++)
+          {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+
+            randomOperation<Versioned>(atom, history, i, random);
+
+            if (random % 7 == 0)
+            {
+              std::this_thread::yield();
+            }
+          }
+        });
+      }
+
+      for (std::thread& thread : threads)
+      {
+        thread.join();
+      }
+
+      if (!CheckLinearizable(history.Operations(), RegisterModel()))
+      {
+        violations++;
+      }
+    }
+
+    return violations;
+  }
+
+  AtomOperation op(Kind kind, int64_t first, int64_t second, Output output,
+                   uint64_t call, uint64_t ret)
+  {
+    return AtomOperation{ Input{ kind, first, second }, output, call, ret };
+  }
+}
+
+TEST_CASE("Linearizability checker accepts overlapping operations", "[Linearizability]")
+{
+  // the read overlaps the write, so it may see either value
+  std::vector<AtomOperation> history
+  {
+    op(Kind::Reset, 1, 0, Output{ 1, 0, false }, 0, 3),
+    op(Kind::Value, 0, 0, Output{ 1, 0, false }, 1, 2),
+    op(Kind::Value, 0, 0, Output{ 1, 0, false }, 4, 5)
+  };
+
+  REQUIRE( CheckLinearizable(history, RegisterModel()) );
+
+  history[1].output.value = 0;
+  REQUIRE( CheckLinearizable(history, RegisterModel()) );
+}
+
+TEST_CASE("Linearizability checker rejects stale reads", "[Linearizability]")
+{
+  // the write returned before the read was called, the read must see it
+  std::vector<AtomOperation> history
+  {
+    op(Kind::Reset, 1, 0, Output{ 1, 0, false }, 0, 1),
+    op(Kind::Value, 0, 0, Output{ 0, 0, false }, 2, 3)
+  };
+
+  REQUIRE( !CheckLinearizable(history, RegisterModel()) );
+}
+
+TEST_CASE("Linearizability checker rejects lost updates", "[Linearizability]")
+{
+  // two overlapping increments which both saw zero: one update was lost
+  std::vector<AtomOperation> history
+  {
+    op(Kind::Swap, 1, 0, Output{ 1, 0, false }, 0, 3),
+    op(Kind::Swap, 1, 0, Output{ 1, 0, false }, 1, 2),
+    op(Kind::Value, 0, 0, Output{ 1, 0, false }, 4, 5)
+  };
+
+  REQUIRE( !CheckLinearizable(history, RegisterModel()) );
+
+  history[0].output.value = 2;
+  history[2].output.value = 2;
+  REQUIRE( CheckLinearizable(history, RegisterModel()) );
+}
+
+TEST_CASE("Linearizable LockFree Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, LockFree>, false>()) == 0 );
+}
+
+TEST_CASE("Linearizable ExclusiveLock Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, ExclusiveLock>>()) == 0 );
+}
+
+TEST_CASE("Linearizable SharedLock Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, SharedLock>>()) == 0 );
+}
+
+TEST_CASE("Linearizable SpinLock Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, SpinLock>>()) == 0 );
+}
+
+TEST_CASE("Linearizable AdaptiveLock Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, AdaptiveLock>>()) == 0 );
+}
+
+TEST_CASE("Linearizable SeqLock Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, SeqLock>>()) == 0 );
+}
+
+TEST_CASE("Linearizable FlatCombining Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, FlatCombining>>()) == 0 );
+}
+
+TEST_CASE("Linearizable LeftRight Atom", "[Linearizability]")
+{
+  REQUIRE( (countViolations<Atom<int64_t, LeftRight>>()) == 0 );
+}
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * Tools for checking that a concurrent object is linearizable: that every
+ * history of operations observed from several threads can be explained by
+ * some sequential order of those operations which respects real time.
+ *
+ * A stress test records a History while threads hammer the object and
+ * hands it to CheckLinearizable() together with a sequential model of the
+ * object. The checker is the Wing & Gong search with the memoization
+ * introduced by Lowe: it repeatedly picks an operation which may come next
+ * (one whose call precedes the earliest pending return), applies it to the
+ * model, and backtracks when the model disagrees with the recorded result.
+ * States already explored with the same set of linearized operations are
+ * skipped, which keeps the search fast for the short histories used here.
+ *
+ * @see https://doi.org/10.1016/0743-7315(93)90123-S
+ *      Testing and Verifying Concurrent Objects
+ * @see https://arxiv.org/abs/1504.00204
+ *      Testing for Linearizability
+ */
+
+/**
+ * One completed operation. `call` and `ret` are ticks of a shared logical
+ * clock taken immediately before the operation was invoked and immediately
+ * after it returned.
+ *
+ * @tparam Input What the operation was asked to do.
+ * @tparam Output What the operation returned.
+ */
+template<typename Input, typename Output>
+struct Operation
+{
+  Input input;
+  Output output;
+  uint64_t call;
+  uint64_t ret;
+};
+
+/**
+ * Collects the operations of several threads. Every thread appends to its
+ * own log, so recording adds nothing but two increments of the shared
+ * clock to each operation.
+ */
+template<typename Input, typename Output>
+class History
+{
+public:
+
+  typedef Operation<Input, Output> OperationType;
+
+  explicit History(size_t threadCount)
+    : mLogs(threadCount)
+    {
+    }
+
+  /**
+   * Calls the function and records it as an operation of the given thread.
+   *
+   * @param thread The index of the calling thread.
+   * @param input What the operation is asked to do.
+   * @param func Performs the operation and returns its output.
+   */
+  template<typename F>
+  void Record(size_t thread, const Input& input, F&& func)
+  {
+    uint64_t call = mClock.fetch_add(1, std::memory_order_seq_cst);
+    Output output = func();
+    uint64_t ret = mClock.fetch_add(1, std::memory_order_seq_cst);
+
+    mLogs[thread].push_back(OperationType{ input, output, call, ret });
+  }
+
+  /**
+   * @return The operations of all threads. Only call once every thread has
+   *         stopped recording.
+   */
+  std::vector<OperationType> Operations() const
+  {
+    std::vector<OperationType> operations;
+
+    for (const std::vector<OperationType>& log : mLogs)
+    {
+      operations.insert(operations.end(), log.begin(), log.end());
+    }
+
+    return operations;
+  }
+
+private:
+
+  std::atomic<uint64_t> mClock{ 0 };
+
+  std::vector<std::vector<OperationType>> mLogs;
+};
+
+/**
+ * Determines whether the history is linearizable with respect to the model.
+ *
+ * The model describes the object sequentially. It must provide
+ *
+ *  - `State`, a copyable, equality comparable type with a `std::hash`,
+ *  - `State Init() const`, the state before the first operation,
+ *  - `bool Step(const State& state, const Operation& op, State& next) const`,
+ *    which returns whether `op.output` is what the object returns for
+ *    `op.input` in `state`, and if so stores the resulting state in `next`.
+ *
+ * @param history The completed operations, in any order.
+ * @param model The sequential model.
+ *
+ * @return `true` if some legal sequential order explains the history.
+ */
+template<typename Model, typename Op>
+bool CheckLinearizable(const std::vector<Op>& history, const Model& model)
+{
+  typedef typename Model::State State;
+
+  /**
+   * A call or return event in the doubly linked list the search lifts
+   * operations out of.
+   */
+  struct Entry
+  {
+    size_t op;
+    bool isCall;
+    uint64_t time;
+    size_t match;
+    size_t prev;
+    size_t next;
+  };
+
+  typedef std::vector<uint64_t> Bits;
+
+  struct Config
+  {
+    Bits linearized;
+    State state;
+
+    bool operator == (const Config& other) const
+    {
+      return linearized == other.linearized && state == other.state;
+    }
+  };
+
+  struct ConfigHash
+  {
+    size_t operator () (const Config& config) const
+    {
+      size_t hash = std::hash<State>()(config.state);
+
+      for (uint64_t word : config.linearized)
+      {
+        hash ^= std::hash<uint64_t>()(word) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+      }
+
+      return hash;
+    }
+  };
+
+  const size_t count = history.size();
+  const size_t head = 2 * count;
+
+  // events in time order; the sentinel at `head` starts the list
+  std::vector<Entry> entries;
+  entries.reserve(2 * count + 1);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    entries.push_back(Entry{ i, true, history[i].call, 0, 0, 0 });
+    entries.push_back(Entry{ i, false, history[i].ret, 0, 0, 0 });
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+  {
+    return a.time < b.time;
+  });
+
+  std::vector<size_t> callOf(count);
+
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].isCall)
+    {
+      callOf[entries[i].op] = i;
+    }
+  }
+
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (!entries[i].isCall)
+    {
+      entries[i].match = callOf[entries[i].op];
+      entries[callOf[entries[i].op]].match = i;
+    }
+  }
+
+  entries.push_back(Entry{ 0, false, 0, 0, head, head });
+
+  size_t last = head;
+
+  for (size_t i = 0; i < head; i++)
+  {
+    entries[i].prev = last;
+    entries[last].next = i;
+    last = i;
+  }
+
+  entries[last].next = head;
+  entries[head].prev = last;
+
+  auto unlink = [&entries](size_t i)
+  {
+    entries[entries[i].prev].next = entries[i].next;
+    entries[entries[i].next].prev = entries[i].prev;
+  };
+
+  auto relink = [&entries](size_t i)
+  {
+    entries[entries[i].prev].next = i;
+    entries[entries[i].next].prev = i;
+  };
+
+  Bits linearized((count + 63) / 64, 0);
+  std::unordered_set<Config, ConfigHash> seen;
+  std::vector<std::pair<size_t, State>> stack;
+
+  State state = model.Init();
+  size_t entry = entries[head].next;
+
+  while (entries[head].next != head)
+  {
+    const Entry& current = entries[entry];
+
+    if (current.isCall)
+    {
+      State next;
+
+      if (model.Step(state, history[current.op], next))
+      {
+        Bits candidate(linearized);
+        candidate[current.op / 64] |= uint64_t(1) << (current.op % 64);
+
+        if (seen.insert(Config{ candidate, next }).second)
+        {
+          // linearize the operation here and restart from the front
+          stack.emplace_back(entry, state);
+          linearized.swap(candidate);
+          state = next;
+
+          unlink(entry);
+          unlink(current.match);
+
+          entry = entries[head].next;
+          continue;
+        }
+      }
+
+      entry = current.next;
+    }
+    else
+    {
+      // a pending operation returned before any candidate fit: backtrack
+      if (stack.empty())
+      {
+        return false;
+      }
+
+      entry = stack.back().first;
+      state = stack.back().second;
+      stack.pop_back();
+
+      const Entry& undone = entries[entry];
+      linearized[undone.op / 64] &= ~(uint64_t(1) << (undone.op % 64));
+
+      relink(undone.match);
+      relink(entry);
+
+      entry = undone.next;
+    }
+  }
+
+  return true;
+}
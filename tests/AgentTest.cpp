@@ -0,0 +1,135 @@
+#include <catch.hh>
+#include <Agent.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Agent runs actions asynchronously and in order", "[Agent]")
+{
+  Agent<std::string> agent{ std::string("") };
+
+  for (char c = 'a'; c <= 'e'; c++)
+  {
+    agent.Send([c](const std::string& value){ return value + c; });
+  }
+
+  agent.Await();
+
+  REQUIRE( agent.Value() == "abcde" );
+  REQUIRE( !agent.Error() );
+}
+
+TEST_CASE("Agent does not block senders while an action runs", "[Agent]")
+{
+  Agent<int> agent{ 0 };
+  std::atomic<bool> release{ false };
+
+  agent.Send([&](const int& value)
+  {
+    while (!release)
+    {
+      std::this_thread::yield();
+    }
+
+    return value + 1;
+  });
+
+  agent.Send([](const int& value){ return value * 10; });
+
+  REQUIRE( agent.Value() == 0 );
+  REQUIRE( !agent.AwaitFor(std::chrono::milliseconds(1)) );
+
+  release = true;
+  agent.Await();
+
+  REQUIRE( agent.Value() == 10 );
+}
+
+TEST_CASE("Agent serializes actions sent from many threads", "[Agent]")
+{
+  Agent<std::vector<int>> agent{ std::vector<int>() };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 4; i++)
+  {
+    threads.emplace_back([&agent]()
+    {
+      for (int j = 0; j < 250; j++)
+      {
+        // not idempotent: concurrent actions would lose elements
+        agent.Send([j](const std::vector<int>& values)
+        {
+          std::vector<int> newValues(values);
+          newValues.push_back(j);
+          return newValues;
+        });
+      }
+    });
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  agent.Await();
+
+  REQUIRE( agent.Value().size() == 1000 );
+}
+
+TEST_CASE("Agent continues after errors by default", "[Agent]")
+{
+  Agent<int> agent{ 1, [](const int& value){ return value > 0; } };
+
+  agent.Send([](const int&) -> int { throw std::runtime_error("boom"); });
+  agent.Send([](const int& value){ return value + 1; });
+  agent.Send([](const int&){ return -1; });
+  agent.Send([](const int& value){ return value + 1; });
+  agent.Await();
+
+  REQUIRE( agent.Value() == 3 );
+  REQUIRE( !agent.Failed() );
+  REQUIRE_THROWS_AS( std::rethrow_exception(agent.Error()), std::invalid_argument& );
+}
+
+TEST_CASE("Failed agent queues actions until restarted", "[Agent]")
+{
+  Agent<int> agent{ 1, nullptr, AgentErrorMode::Fail };
+
+  REQUIRE_THROWS_AS( agent.Restart(0), std::logic_error& );
+
+  agent.Send([](const int&) -> int { throw std::runtime_error("boom"); });
+  agent.Send([](const int& value){ return value + 1; });
+  agent.Await();
+
+  REQUIRE( agent.Failed() );
+  REQUIRE( agent.Value() == 1 );
+  REQUIRE_THROWS_AS( std::rethrow_exception(agent.Error()), std::runtime_error& );
+
+  agent.Send([](const int& value){ return value * 10; });
+
+  agent.Restart(5);
+  agent.Await();
+
+  REQUIRE( !agent.Failed() );
+  REQUIRE( !agent.Error() );
+  REQUIRE( agent.Value() == 60 );
+}
+
+TEST_CASE("Agent runs actions on the given executor", "[Agent]")
+{
+  Agent<int> agent{ 0, nullptr, AgentErrorMode::Continue, InlineExecutor::Instance() };
+
+  agent.Send([&agent](const int& value)
+  {
+    // sent from inside an action: queued behind it rather than nested
+    agent.Send([](const int& value){ return value * 2; });
+    return value + 1;
+  });
+
+  REQUIRE( agent.Value() == 2 );
+}
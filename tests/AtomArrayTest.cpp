@@ -0,0 +1,160 @@
+#include <catch.hh>
+#include <AtomArray.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  template<typename VectorType>
+  void requireAtomOperations(VectorType& subject)
+  {
+    REQUIRE( subject.Value(0) == 0 );
+
+    REQUIRE( subject.Reset(1, 10) == 10 );
+    REQUIRE( subject.Reset(1, [](const uint64_t& value){ return value + 1; }) == 11 );
+    REQUIRE( subject.Swap(2, [](const uint64_t& value){ return value + 5; }) == 5 );
+    REQUIRE( subject.Modify(3, [](uint64_t& value){ value = 7; }) == 7 );
+
+    REQUIRE( subject.CompareAndSet(3, 7, 8) );
+    REQUIRE( !subject.CompareAndSet(3, 7, 9) );
+    REQUIRE( subject.Value(3) == 8 );
+
+    uint64_t seen{ 0 };
+    subject.With(1, [&seen](const uint64_t& value){ seen = value; });
+    REQUIRE( seen == 11 );
+
+    std::vector<uint64_t> snapshot = subject.Snapshot();
+    REQUIRE( snapshot.size() == subject.Size() );
+    REQUIRE( snapshot[0] == 0 );
+    REQUIRE( snapshot[1] == 11 );
+    REQUIRE( snapshot[2] == 5 );
+    REQUIRE( snapshot[3] == 8 );
+
+    uint64_t sum{ 0 };
+    size_t visited{ 0 };
+    subject.ForEach([&](size_t, const uint64_t& value){ sum += value; visited++; });
+    REQUIRE( sum == 24 );
+    REQUIRE( visited == subject.Size() );
+  }
+
+  template<typename VectorType>
+  void requireNoLostUpdates(VectorType& subject)
+  {
+    const int threadCount = 4;
+    const int iterations = 2000;
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+      threads.emplace_back([&subject, i]()
+      {
+        for (int j = 0; j < iterations; j++)
+        {
+          size_t index = static_cast<size_t>(i + j) % subject.Size();
+
+          if (j % 2 == 0)
+          {
+            subject.Swap(index, [](const uint64_t& value){ return value + 1; });
+          }
+          else
+          {
+            subject.Modify(index, [](uint64_t& value){ value++; });
+          }
+        }
+      });
+    }
+
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+
+    uint64_t sum{ 0 };
+
+    for (uint64_t value : subject.Snapshot())
+    {
+      sum += value;
+    }
+
+    REQUIRE( sum == threadCount * iterations );
+  }
+}
+
+TEST_CASE("AtomVector padded layout", "[AtomArray]")
+{
+  AtomVector<uint64_t> subject(10);
+
+  REQUIRE( subject.Size() == 10 );
+  requireAtomOperations(subject);
+}
+
+TEST_CASE("AtomVector striped layout", "[AtomArray]")
+{
+  AtomVector<uint64_t, StripedLayout<4>> subject(10);
+
+  REQUIRE( subject.Size() == 10 );
+  requireAtomOperations(subject);
+}
+
+TEST_CASE("AtomVector with fewer elements than stripes", "[AtomArray]")
+{
+  AtomVector<std::string, StripedLayout<16>> subject(2, "foo");
+
+  REQUIRE( subject.Value(1) == "foo" );
+  REQUIRE( subject.Reset(1, "bar") == "bar" );
+  REQUIRE( (subject.Snapshot() == std::vector<std::string>{ "foo", "bar" }) );
+}
+
+TEST_CASE("AtomArray", "[AtomArray]")
+{
+  AtomArray<uint64_t, 4, PaddedLayout, AdaptiveMutex> subject;
+
+  REQUIRE( subject.Size() == 4 );
+  requireAtomOperations(subject);
+}
+
+TEST_CASE("AtomVector padded layout under contention", "[AtomArray]")
+{
+  AtomVector<uint64_t> subject(3);
+  requireNoLostUpdates(subject);
+}
+
+TEST_CASE("AtomVector striped layout under contention", "[AtomArray]")
+{
+  AtomVector<uint64_t, StripedLayout<2>> subject(5);
+  requireNoLostUpdates(subject);
+}
+
+TEST_CASE("AtomVector of bool striped layout", "[AtomArray]")
+{
+  const size_t size = 8;
+
+  // with packed storage neighbours would share a word under different locks
+  AtomVector<bool, StripedLayout<size>> subject(size);
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < size; i++)
+  {
+    threads.emplace_back([&subject, i]()
+    {
+      for (int j = 0; j < 2001; j++)
+      {
+        subject.Modify(i, [](bool& value){ value = !value; });
+      }
+    });
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( (subject.Snapshot() == std::vector<bool>(size, true)) );
+  REQUIRE( subject.CompareAndSet(3, true, false) );
+  REQUIRE( !subject.Value(3) );
+  REQUIRE( subject.Value(4) );
+}
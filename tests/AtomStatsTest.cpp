@@ -0,0 +1,150 @@
+#include <catch.hh>
+#include <Atom.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("AtomStats disabled by default", "[AtomStats]")
+{
+  Atom<std::string> subject{ std::string("foo") };
+
+  subject.Value();
+  subject.Reset("bar");
+
+  AtomStatistics stats = subject.Statistics();
+  REQUIRE( stats.reads == 0 );
+  REQUIRE( stats.writes == 0 );
+  REQUIRE( stats.copies == 0 );
+  REQUIRE( stats.waitTime.Count() == 0 );
+}
+
+TEST_CASE("AtomStats lock acquisitions, copies and validation", "[AtomStats]")
+{
+  typedef Atom<std::string, ExclusiveLock, Atom<std::string>::ValidateFunc, AtomStats> AtomType;
+
+  AtomType subject(std::string("foo"), [](const std::string& newValue){ return !newValue.empty(); });
+
+  subject.Value();
+  subject.Value();
+  subject.Reset(std::string("bar"));
+  subject.Reset(std::string());
+  subject.With([](const std::string&){});
+
+  AtomStatistics stats = subject.Statistics();
+  REQUIRE( stats.reads == 3 );
+  REQUIRE( stats.writes == 2 );
+  REQUIRE( stats.copies == 4 );
+  REQUIRE( stats.validationFailures == 1 );
+  REQUIRE( stats.waitTime.Count() == 5 );
+  REQUIRE( stats.holdTime.Count() == 5 );
+
+  subject.ClearStatistics();
+  stats = subject.Statistics();
+  REQUIRE( stats.reads == 0 );
+  REQUIRE( stats.holdTime.Count() == 0 );
+}
+
+TEST_CASE("AtomStats Swap retries", "[AtomStats]")
+{
+  typedef Atom<uint64_t, SharedLock, Atom<uint64_t>::ValidateFunc, AtomStats> AtomType;
+
+  AtomType subject(0);
+  bool interfered{ false };
+
+  // another write lands between the first read and the first commit
+  subject.Swap([&](const uint64_t& currentValue)
+  {
+    if (!interfered)
+    {
+      interfered = true;
+      subject.Reset(uint64_t(100));
+    }
+
+    return currentValue + 1;
+  });
+
+  REQUIRE( subject.Value() == 101 );
+
+  AtomStatistics stats = subject.Statistics();
+  REQUIRE( stats.swaps == 1 );
+  REQUIRE( stats.swapRetries == 1 );
+  REQUIRE( stats.swapAttempts.Count() == 1 );
+  REQUIRE( stats.swapAttempts.Percentile(0.5) == 3 );
+}
+
+TEST_CASE("AtomStats lock-free Swap", "[AtomStats]")
+{
+  typedef Atom<int, LockFree, Atom<int>::ValidateFunc, AtomStats> AtomType;
+
+  AtomType subject(0, [](const int& newValue){ return newValue < 10; });
+
+  subject.Swap([](const int& currentValue){ return currentValue + 1; });
+  subject.Swap([](const int&){ return 20; }, 3);
+
+  AtomStatistics stats = subject.Statistics();
+  REQUIRE( subject.Value() == 1 );
+  REQUIRE( stats.swaps == 2 );
+  REQUIRE( stats.swapRetries == 2 );
+  REQUIRE( stats.validationFailures == 3 );
+  REQUIRE( stats.reads == 0 );
+}
+
+TEST_CASE("AtomStats under contention", "[AtomStats]")
+{
+  typedef Atom<std::vector<int>, ExclusiveLock, Atom<std::vector<int>>::ValidateFunc, AtomStats> AtomType;
+
+  const int threadCount = 4;
+  const int iterations = 500;
+
+  AtomType subject{ std::vector<int>() };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        subject.Swap([](const std::vector<int>& currentValue)
+        {
+          std::vector<int> newValue(currentValue);
+          newValue.push_back(1);
+          return newValue;
+        });
+      }
+    });
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  AtomStatistics stats = subject.Statistics();
+  REQUIRE( subject.Value().size() == threadCount * iterations );
+  REQUIRE( stats.swaps == threadCount * iterations );
+  REQUIRE( stats.swapAttempts.Count() == stats.swaps );
+  REQUIRE( stats.writes == stats.swaps + stats.swapRetries );
+  REQUIRE( stats.waitTime.Count() == stats.reads + stats.writes );
+  REQUIRE( stats.waitTime.Percentile(0.999) >= stats.waitTime.Percentile(0.5) );
+}
+
+TEST_CASE("Histogram percentiles", "[AtomStats]")
+{
+  Histogram histogram;
+
+  for (uint64_t i = 0; i < 99; i++)
+  {
+    histogram.Record(5);
+  }
+
+  histogram.Record(1000);
+
+  HistogramSnapshot snapshot = histogram.Snapshot();
+  REQUIRE( snapshot.Count() == 100 );
+  REQUIRE( snapshot.Percentile(0.5) == 7 );
+  REQUIRE( snapshot.Percentile(1.0) == 1023 );
+  REQUIRE( HistogramSnapshot().Percentile(0.99) == 0 );
+}
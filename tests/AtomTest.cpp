@@ -1,6 +1,13 @@
 #include <catch.hh>
 #include <Atom.h>
 
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 TEST_CASE("Initialization", "[Atom]")
 {
   typedef uint64_t ValueType;
@@ -196,3 +203,557 @@ TEST_CASE("Modify", "[Atom]")
   REQUIRE( actual.first == initial.first );
   REQUIRE( actual.second == expected );
 }
+
+TEST_CASE("Lock-free selection", "[Atom]")
+{
+  REQUIRE( IsLockFreeAtom<uint64_t>::value );
+  REQUIRE( IsLockFreeAtom<bool>::value );
+  REQUIRE( !IsLockFreeAtom<std::string>::value );
+  REQUIRE( !(IsLockFreeAtom<std::pair<std::string, uint64_t>>::value) );
+}
+
+namespace
+{
+  /**
+   * A struct with padding between its members.
+   */
+  struct Padded
+  {
+    char tag;
+    int value;
+
+    bool operator == (const Padded& other) const
+    {
+      return tag == other.tag && value == other.value;
+    }
+  };
+
+  /**
+   * A struct whose equality ignores part of its bytes.
+   */
+  struct Keyed
+  {
+    int key;
+    int payload;
+
+    bool operator == (const Keyed& other) const
+    {
+      return key == other.key;
+    }
+  };
+}
+
+TEST_CASE("Lock-free is only the default where bytes and operator== agree", "[Atom]")
+{
+  REQUIRE( (std::is_same<Atom<int>, Atom<int, LockFree>>::value) );
+  REQUIRE( (std::is_same<Atom<int*>, Atom<int*, LockFree>>::value) );
+  REQUIRE( (std::is_same<Atom<double>, Atom<double, ExclusiveLock>>::value) );
+  REQUIRE( (std::is_same<Atom<Padded>, Atom<Padded, ExclusiveLock>>::value) );
+  REQUIRE( (std::is_same<Atom<Keyed>, Atom<Keyed, ExclusiveLock>>::value) );
+
+  Padded stored;
+  Padded expected;
+  std::memset(&stored, 0x00, sizeof(Padded));
+  std::memset(&expected, 0xff, sizeof(Padded));
+  stored.tag = expected.tag = 'a';
+  stored.value = expected.value = 1;
+
+  Atom<Padded> padded(stored);
+  REQUIRE( padded.CompareAndSet(expected, Padded{ 'b', 2 }) );
+
+  Atom<Keyed> keyed(Keyed{ 1, 2 });
+  REQUIRE( keyed.CompareAndSet(Keyed{ 1, 3 }, Keyed{ 4, 5 }) );
+
+  Atom<double> zero(-0.0);
+  REQUIRE( zero.CompareAndSet(0.0, 1.0) );
+}
+
+TEST_CASE("CompareAndSet (locking, without validation)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+
+  ValueType initial, actual, expected;
+
+  initial = 0;
+  AtomType subject(initial);
+
+  expected = 100;
+  REQUIRE( subject.CompareAndSet(initial, expected) );
+
+  actual = subject.Value();
+  REQUIRE( actual == expected);
+
+  REQUIRE( !subject.CompareAndSet(initial, expected + 1) );
+  REQUIRE( subject.Value() == expected );
+}
+
+TEST_CASE("CompareAndSet (lock-free, with validation)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(0, [](const ValueType& newValue){ return newValue < 100; });
+
+  REQUIRE( subject.CompareAndSet(0, 50) );
+  REQUIRE( subject.Value() == 50 );
+
+  REQUIRE( !subject.CompareAndSet(50, 150) );
+  REQUIRE( subject.Value() == 50 );
+
+  REQUIRE( subject.Reset(150) == 50 );
+  REQUIRE( subject.Reset(
+      [](const ValueType& currentValue)
+      { return currentValue + 10; }) == 60 );
+}
+
+TEST_CASE("Swap (lock-free, with validation and max attempts)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(0, [](const ValueType& newValue){ return newValue < 100; });
+
+  subject.Swap(
+      [](const ValueType& currentValue)
+      { return currentValue + 200; }, 3);
+  REQUIRE( subject.Value() == 0 );
+}
+
+TEST_CASE("Modify (lock-free)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(1);
+
+  ValueType actual = subject.Modify(
+      [](ValueType& currentValue)
+      { currentValue *= 42; });
+
+  REQUIRE( actual == 42 );
+  REQUIRE( subject.Value() == 42 );
+}
+
+TEST_CASE("Swap (lock-free, concurrent)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  const int threadCount = 4;
+  const int iterations = 10000;
+
+  AtomType subject(0);
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        subject.Swap([](const ValueType& currentValue)
+                     { return currentValue + 1; });
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( subject.Value() == threadCount * iterations );
+}
+
+TEST_CASE("Reset and Modify (lock-free) retry after a racing write", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(0);
+  int calls{ 0 };
+  std::thread writer;
+
+  // a write racing with the function makes the compare-and-swap loop retry
+  auto race = [&]()
+  {
+    writer = std::thread([&subject]()
+    {
+      subject.Swap([](const ValueType& currentValue){ return currentValue + 1; });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  };
+
+  ValueType actual = subject.Reset([&](const ValueType& currentValue)
+                                   {
+                                     if (++calls == 1)
+                                     {
+                                       race();
+                                     }
+                                     return currentValue + 10;
+                                   });
+  writer.join();
+
+  REQUIRE( actual == 11 );
+  REQUIRE( calls == 2 );
+  REQUIRE( subject.Value() == 11 );
+
+  actual = subject.Modify([&](ValueType& currentValue)
+                          {
+                            if (++calls == 3)
+                            {
+                              race();
+                            }
+                            currentValue += 10;
+                          });
+  writer.join();
+
+  REQUIRE( actual == 22 );
+  REQUIRE( calls == 4 );
+  REQUIRE( subject.Value() == 22 );
+}
+
+TEST_CASE("ValueWithVersion", "[Atom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1 });
+
+  std::pair<ValueType, uint64_t> actual = subject.ValueWithVersion();
+  REQUIRE( actual.first == ValueType{ 1 } );
+  REQUIRE( actual.second == 0 );
+
+  subject = ValueType{ 2 };
+  subject.Modify([](ValueType& currentValue){ currentValue.push_back(3); });
+
+  actual = subject.ValueWithVersion();
+  REQUIRE( actual.first == (ValueType{ 2, 3 }) );
+  REQUIRE( actual.second == 2 );
+  REQUIRE( subject.Version() == 2 );
+}
+
+TEST_CASE("CompareAndSetVersion", "[Atom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1 }, [](const ValueType& newValue){ return !newValue.empty(); });
+
+  uint64_t version = subject.Version();
+
+  REQUIRE( !subject.CompareAndSetVersion(version, ValueType()) );
+  REQUIRE( subject.CompareAndSetVersion(version, ValueType{ 2 }) );
+  REQUIRE( subject.Value() == ValueType{ 2 } );
+
+  // writing an equal value still invalidates the old version
+  subject = ValueType{ 1 };
+  REQUIRE( !subject.CompareAndSetVersion(version, ValueType{ 3 }) );
+  REQUIRE( subject.Value() == ValueType{ 1 } );
+}
+
+TEST_CASE("Swap (concurrent, large value)", "[Atom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  const int threadCount = 4;
+  const int iterations = 1000;
+
+  AtomType subject{ ValueType() };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject, i]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        subject.Swap([i](const ValueType& currentValue)
+                     {
+                       ValueType newValue(currentValue);
+                       newValue.push_back(i);
+                       return newValue;
+                     });
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( subject.Value().size() == threadCount * iterations );
+  REQUIRE( subject.Version() == threadCount * iterations );
+}
+
+namespace
+{
+  struct LessThanOneHundred
+  {
+    bool operator () (const uint64_t& newValue) const
+    {
+      return newValue < 100;
+    }
+  };
+}
+
+TEST_CASE("Compile-time validator", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock, LessThanOneHundred> AtomType;
+
+  AtomType subject(0);
+
+  REQUIRE( subject.Reset(50) == 50 );
+  REQUIRE( subject.Reset(150) == 50 );
+  REQUIRE( !subject.CompareAndSet(50, 150) );
+
+  typedef Atom<ValueType, LockFree, LessThanOneHundred> LockFreeAtomType;
+
+  LockFreeAtomType lockFree(0);
+
+  REQUIRE( lockFree.Reset(50) == 50 );
+  REQUIRE( lockFree.Reset(150) == 50 );
+}
+
+TEST_CASE("Callables of any type", "[Atom]")
+{
+  typedef std::string ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject("foo");
+
+  // a capture too large for std::function's small buffer
+  std::string suffix("bar");
+  uint64_t padding[4] = { 0, 0, 0, 0 };
+
+  subject.Reset([suffix, padding](const ValueType& currentValue)
+                { return currentValue + suffix + std::to_string(padding[0]); });
+  REQUIRE( subject.Value() == "foobar0" );
+
+  AtomType::UpdateFunc update = [](const ValueType& currentValue)
+                                { return currentValue + "!"; };
+  REQUIRE( subject.Reset(update) == "foobar0!" );
+  REQUIRE( subject.Swap(update) == "foobar0!!" );
+}
+
+namespace
+{
+  /**
+   * A value which counts how often it has been copied.
+   */
+  struct CopyCounter
+  {
+    static int copies;
+
+    std::vector<uint64_t> data;
+
+    CopyCounter() = default;
+    explicit CopyCounter(size_t size) : data(size) {  }
+    CopyCounter(const CopyCounter& other) : data(other.data) { copies++; }
+    CopyCounter(CopyCounter&&) = default;
+    CopyCounter& operator = (const CopyCounter& other) { data = other.data; copies++; return *this; }
+    CopyCounter& operator = (CopyCounter&&) = default;
+
+    bool operator == (const CopyCounter& other) const { return data == other.data; }
+  };
+
+  int CopyCounter::copies = 0;
+}
+
+TEST_CASE("Move semantics", "[Atom]")
+{
+  typedef CopyCounter ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  CopyCounter::copies = 0;
+
+  AtomType subject(ValueType(10));
+  subject = ValueType(20);
+  REQUIRE( subject.CompareAndSetVersion(subject.Version(), ValueType(30)) );
+  REQUIRE( subject.Emplace(40) );
+
+  ValueType previous = subject.Exchange(ValueType(50));
+  REQUIRE( previous.data.size() == 40 );
+
+  ValueType taken = subject.Take();
+  REQUIRE( taken.data.size() == 50 );
+
+  REQUIRE( CopyCounter::copies == 0 );
+  REQUIRE( subject.Value().data.empty() );
+  REQUIRE( subject.Version() == 5 );
+}
+
+TEST_CASE("Emplace (with validation)", "[Atom]")
+{
+  typedef std::string ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject("foo", [](const ValueType& newValue){ return newValue.size() < 5; });
+
+  REQUIRE( subject.Emplace(3, 'x') );
+  REQUIRE( subject.Value() == "xxx" );
+
+  REQUIRE( !subject.Emplace(10, 'y') );
+  REQUIRE( subject.Value() == "xxx" );
+}
+
+TEST_CASE("Exchange and Take (lock-free)", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject(42);
+
+  REQUIRE( subject.Exchange(7) == 42 );
+  REQUIRE( subject.Take() == 7 );
+  REQUIRE( subject.Value() == 0 );
+  REQUIRE( subject.Emplace(9) );
+  REQUIRE( subject.Value() == 9 );
+}
+
+namespace
+{
+  template<typename Backoff>
+  void requireSwapWithBackoff(Backoff backoff)
+  {
+    typedef std::vector<uint64_t> ValueType;
+    typedef Atom<ValueType> AtomType;
+    typedef Atom<uint64_t> LockFreeAtomType;
+
+    const int threadCount = 4;
+    const int iterations = 500;
+
+    AtomType subject{ ValueType() };
+    LockFreeAtomType counter(0);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+      threads.emplace_back([&subject, &counter, backoff]()
+      {
+        for (int j = 0; j < iterations; j++)
+        {
+          subject.Swap([](const ValueType& currentValue)
+                       {
+                         ValueType newValue(currentValue);
+                         newValue.push_back(newValue.size());
+                         return newValue;
+                       }, backoff);
+          counter.Swap([](const uint64_t& currentValue)
+                       { return currentValue + 1; }, backoff);
+        }
+      });
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    REQUIRE( subject.Value().size() == threadCount * iterations );
+    REQUIRE( counter.Value() == threadCount * iterations );
+  }
+}
+
+TEST_CASE("Swap with backoff", "[Atom]")
+{
+  requireSwapWithBackoff(NoBackoff());
+  requireSwapWithBackoff(PauseBackoff());
+  requireSwapWithBackoff(YieldBackoff());
+  requireSwapWithBackoff(ExponentialBackoff());
+  requireSwapWithBackoff(ExponentialBackoff(0, 16));
+  requireSwapWithBackoff(ParkingBackoff(2, std::chrono::microseconds(1)));
+}
+
+TEST_CASE("Swap with backoff and max attempts", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+
+  AtomType subject(0, [](const ValueType& newValue){ return newValue < 100; });
+
+  int backoffs{ 0 };
+  subject.Swap([](const ValueType& currentValue){ return currentValue + 200; },
+               [&backoffs](int){ backoffs++; }, 3);
+
+  REQUIRE( backoffs == 2 );
+  REQUIRE( subject.Value() == 0 );
+}
+
+TEST_CASE("SwapFor", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+  typedef Atom<ValueType> LockFreeAtomType;
+
+  auto increment = [](const ValueType& currentValue){ return currentValue + 1; };
+  auto invalid = [](const ValueType& newValue){ return newValue < 100; };
+
+  AtomType subject(0, invalid);
+  REQUIRE( subject.SwapFor(increment, std::chrono::milliseconds(10)) == ValueType(1) );
+  REQUIRE( !subject.SwapFor([](const ValueType&){ return ValueType(200); },
+                            std::chrono::milliseconds(1), YieldBackoff()) );
+
+  LockFreeAtomType lockFree(0, invalid);
+  REQUIRE( lockFree.SwapFor(increment, std::chrono::milliseconds(10)) == ValueType(1) );
+  REQUIRE( !lockFree.SwapUntil([](const ValueType&){ return ValueType(200); },
+                               std::chrono::steady_clock::now() + std::chrono::milliseconds(1),
+                               PauseBackoff()) );
+}
+
+TEST_CASE("ResetBatch", "[Atom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  auto append = [](uint64_t item)
+  {
+    return [item](const ValueType& currentValue)
+           {
+             ValueType newValue(currentValue);
+             newValue.push_back(item);
+             return newValue;
+           };
+  };
+
+  AtomType subject(ValueType(), [](const ValueType& newValue){ return newValue.size() <= 3; });
+
+  std::vector<AtomType::UpdateFunc> funcs{ append(1), append(2) };
+  REQUIRE( subject.ResetBatch(funcs) == (ValueType{ 1, 2 }) );
+  REQUIRE( subject.Version() == 1 );
+
+  // the final value is invalid, so nothing happens
+  REQUIRE( subject.ResetBatch({ append(3), append(4) }) == (ValueType{ 1, 2 }) );
+  REQUIRE( subject.Version() == 1 );
+
+  // the second step is invalid and skipped, the others apply
+  REQUIRE( subject.ResetBatch({ [](const ValueType& currentValue)
+                                { return ValueType(currentValue.begin() + 1, currentValue.end()); },
+                                append(5), append(6), append(7) },
+                              BatchValidation::EachStep) == (ValueType{ 2, 5, 6 }) );
+}
+
+TEST_CASE("SwapBatch", "[Atom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, SharedLock> AtomType;
+  typedef Atom<ValueType> LockFreeAtomType;
+
+  auto increment = [](const ValueType& currentValue){ return currentValue + 1; };
+  auto triple = [](const ValueType& currentValue){ return currentValue * 3; };
+  auto small = [](const ValueType& newValue){ return newValue < 10; };
+
+  AtomType subject(1, small);
+  REQUIRE( subject.SwapBatch({ increment, triple }) == 6 );
+  REQUIRE( subject.SwapBatch({ increment, triple }, BatchValidation::EachStep) == 7 );
+
+  LockFreeAtomType lockFree(1, small);
+  REQUIRE( lockFree.SwapBatch({ increment, triple }) == 6 );
+  REQUIRE( lockFree.ResetBatch({ increment, triple }, BatchValidation::EachStep) == 7 );
+  REQUIRE( lockFree.ResetBatch({ increment, triple }) == 7 );
+}
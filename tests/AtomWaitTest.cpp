@@ -0,0 +1,125 @@
+#include <catch.hh>
+#include <Atom.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("WaitUntil returns once a writer satisfies the predicate", "[Wait]")
+{
+  Atom<std::string> subject{ std::string("") };
+
+  std::thread writer([&]()
+  {
+    for (int i = 0; i < 10; i++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      subject.Modify([](std::string& value){ value += "x"; });
+    }
+  });
+
+  std::string value = subject.WaitUntil([](const std::string& value){ return value.size() >= 5; });
+  writer.join();
+
+  REQUIRE( value.size() >= 5 );
+  REQUIRE( subject.Value().size() == 10 );
+}
+
+TEST_CASE("WaitUntil returns immediately if the predicate holds", "[Wait]")
+{
+  Atom<std::string> subject{ std::string("ready") };
+
+  REQUIRE( subject.WaitUntil([](const std::string& value){ return value == "ready"; }) == "ready" );
+}
+
+TEST_CASE("WaitFor gives up after the timeout", "[Wait]")
+{
+  Atom<std::string> subject{ std::string("foo") };
+
+  auto start = std::chrono::steady_clock::now();
+  std::optional<std::string> value = subject.WaitFor([](const std::string& value){ return value == "bar"; },
+                                                     std::chrono::milliseconds(20));
+
+  REQUIRE( !value );
+  REQUIRE( std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20) );
+
+  std::thread writer([&]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    subject.Reset(std::string("bar"));
+  });
+
+  value = subject.WaitFor([](const std::string& value){ return value == "bar"; },
+                          std::chrono::seconds(10));
+  writer.join();
+
+  REQUIRE( value == std::string("bar") );
+}
+
+TEST_CASE("WaitChange returns the version of the next write", "[Wait]")
+{
+  Atom<std::string> subject{ std::string("foo") };
+
+  std::pair<std::string, uint64_t> current = subject.ValueWithVersion();
+
+  std::thread writer([&]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    subject.Reset(std::string("bar"));
+  });
+
+  uint64_t version = subject.WaitChange(current.second);
+  writer.join();
+
+  REQUIRE( version != current.second );
+  REQUIRE( subject.WaitChange(current.second) == subject.Version() );
+}
+
+TEST_CASE("WaitUntil works with every lock policy", "[Wait]")
+{
+  Atom<int, SeqLock> seqLock{ 0 };
+  Atom<std::string, LeftRight> leftRight{ std::string("") };
+
+  std::thread writer([&]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    seqLock.Reset(42);
+    leftRight.Swap([](const std::string&){ return std::string("done"); });
+  });
+
+  REQUIRE( seqLock.WaitUntil([](const int& value){ return value != 0; }) == 42 );
+  REQUIRE( leftRight.WaitUntil([](const std::string& value){ return !value.empty(); }) == "done" );
+  writer.join();
+}
+
+TEST_CASE("LockFree WaitUntil wakes every waiting thread", "[Wait]")
+{
+  Atom<bool, LockFree> flag{ false };
+  std::atomic<int> woken{ 0 };
+  std::vector<std::thread> waiters;
+
+  for (int i = 0; i < 4; i++)
+  {
+    waiters.emplace_back([&]()
+    {
+      if (flag.WaitUntil([](const bool& value){ return value; }))
+      {
+        woken++;
+      }
+    });
+  }
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  flag = true;
+
+  for (std::thread& waiter : waiters)
+  {
+    waiter.join();
+  }
+
+  REQUIRE( woken == 4 );
+  REQUIRE( !flag.WaitFor([](const bool& value){ return !value; }, std::chrono::milliseconds(1)) );
+}
@@ -0,0 +1,377 @@
+#include <catch.hh>
+#include <Atom.h>
+#include <ThreadPoolExecutor.h>
+
+#include <atomic>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  /**
+   * Queues tasks until the test runs them.
+   */
+  class ManualExecutor : public Executor
+  {
+  public:
+
+    void Execute(Task task) override
+    {
+      mTasks.push_back(std::move(task));
+    }
+
+    size_t Pending() const
+    {
+      return mTasks.size();
+    }
+
+    void RunAll()
+    {
+      while (!mTasks.empty())
+      {
+        Task task = std::move(mTasks.front());
+        mTasks.pop_front();
+        task();
+      }
+    }
+
+  private:
+
+    std::deque<Task> mTasks;
+  };
+
+  typedef std::vector<std::pair<std::string, std::string>> Changes;
+}
+
+TEST_CASE("Watchers are told about every successful write", "[Watch]")
+{
+  Atom<std::string> subject{ std::string("a") };
+  Changes changes;
+
+  subject.AddWatch("log", [&](const std::string& oldValue, const std::string& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+  });
+
+  subject.Reset(std::string("b"));
+  subject.Swap([](const std::string& value){ return value + "c"; });
+  subject.Modify([](std::string& value){ value += "d"; });
+  REQUIRE( subject.CompareAndSet(std::string("bcd"), std::string("e")) );
+  REQUIRE( !subject.CompareAndSet(std::string("nope"), std::string("f")) );
+  subject = std::string("g");
+
+  REQUIRE( (changes == Changes{ { "a", "b" }, { "b", "bc" }, { "bc", "bcd" }, { "bcd", "e" }, { "e", "g" } }) );
+}
+
+TEST_CASE("Watchers are not told about rejected writes", "[Watch]")
+{
+  Atom<int, ExclusiveLock> subject{ 1, [](const int& value){ return value > 0; } };
+  int calls{ 0 };
+
+  subject.AddWatch("count", [&](const int&, const int&){ calls++; });
+
+  subject.Reset(-1);
+  subject.Reset([](const int&){ return -2; });
+  subject.Reset(2);
+
+  REQUIRE( calls == 1 );
+  REQUIRE( subject.Value() == 2 );
+}
+
+TEST_CASE("Watchers run outside the lock", "[Watch]")
+{
+  Atom<int, ExclusiveLock> subject{ 0 };
+  std::vector<int> seen;
+
+  subject.AddWatch("reader", [&](const int&, const int&)
+  {
+    seen.push_back(subject.Value());
+  });
+
+  subject.Reset(1);
+  subject.Reset(2);
+
+  REQUIRE( (seen == std::vector<int>{ 1, 2 }) );
+}
+
+TEST_CASE("Watchers can be replaced and removed", "[Watch]")
+{
+  Atom<int, ExclusiveLock> subject{ 0 };
+  int first{ 0 };
+  int second{ 0 };
+
+  subject.AddWatch("watch", [&](const int&, const int&){ first++; });
+  subject.Reset(1);
+
+  subject.AddWatch("watch", [&](const int&, const int&){ second++; });
+  subject.Reset(2);
+
+  REQUIRE( subject.RemoveWatch("watch") );
+  REQUIRE( !subject.RemoveWatch("watch") );
+  subject.Reset(3);
+
+  REQUIRE( first == 1 );
+  REQUIRE( second == 1 );
+}
+
+TEST_CASE("Watchers run on the given executor", "[Watch]")
+{
+  ManualExecutor executor;
+  Atom<int, ExclusiveLock> subject{ 0 };
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+  }, executor);
+
+  subject.Reset(1);
+  subject.Reset(2);
+
+  REQUIRE( changes.empty() );
+  REQUIRE( executor.Pending() == 2 );
+
+  executor.RunAll();
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 0, 1 }, { 1, 2 } }) );
+
+  subject.Reset(3);
+  subject.RemoveWatch("log");
+  executor.RunAll();
+  REQUIRE( changes.size() == 2 );
+}
+
+TEST_CASE("Coalescing watchers merge changes made while they are busy", "[Watch]")
+{
+  ManualExecutor executor;
+  Atom<int, ExclusiveLock> subject{ 0 };
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+  }, executor, WatchMode::Coalesce);
+
+  subject.Reset(1);
+  subject.Reset(2);
+  subject.Reset(3);
+
+  REQUIRE( executor.Pending() == 1 );
+
+  executor.RunAll();
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 0, 3 } }) );
+
+  subject.Reset(4);
+  executor.RunAll();
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 0, 3 }, { 3, 4 } }) );
+}
+
+TEST_CASE("Coalescing inline watchers report writes made while they run", "[Watch]")
+{
+  Atom<int, ExclusiveLock> subject{ 0 };
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+
+    // a write from inside the watcher is merged rather than recursing
+    if (newValue == 1)
+    {
+      subject.Reset(2);
+      subject.Reset(3);
+    }
+  }, InlineExecutor::Instance(), WatchMode::Coalesce);
+
+  subject.Reset(1);
+
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 0, 1 }, { 1, 3 } }) );
+}
+
+TEST_CASE("Coalescing watchers drop changes older than one already reported", "[Watch]")
+{
+  ManualExecutor executor;
+  Watches<int> watches;
+  std::vector<std::pair<int, int>> changes;
+
+  watches.Add("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+  }, executor, WatchMode::Coalesce);
+
+  // the writer of version 1 is overtaken by the writer of version 2
+  watches.Notify(1, 2, 2);
+  executor.RunAll();
+
+  watches.Notify(0, 1, 1);
+  REQUIRE( executor.Pending() == 0 );
+
+  watches.Notify(2, 3, 3);
+  executor.RunAll();
+
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 1, 2 }, { 2, 3 } }) );
+}
+
+TEST_CASE("Exceptions thrown by watchers are dropped", "[Watch]")
+{
+  Atom<int, ExclusiveLock> subject{ 0 };
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+
+    if (newValue == 1)
+    {
+      throw std::runtime_error("watcher failed");
+    }
+  }, InlineExecutor::Instance(), WatchMode::Coalesce);
+
+  REQUIRE_NOTHROW( subject.Reset(1) );
+  REQUIRE_NOTHROW( subject.Reset(2) );
+
+  REQUIRE( subject.Value() == 2 );
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 0, 1 }, { 1, 2 } }) );
+
+  std::atomic<int> calls{ 0 };
+
+  {
+    ThreadPoolExecutor executor(2);
+
+    for (WatchMode mode : { WatchMode::EveryChange, WatchMode::Coalesce })
+    {
+      subject.AddWatch(mode == WatchMode::Coalesce ? "coalesce" : "every",
+                       [&](const int&, const int&)
+      {
+        calls++;
+        throw std::runtime_error("watcher failed");
+      }, executor, mode);
+    }
+
+    for (int i = 3; i < 100; i++)
+    {
+      subject.Reset(i);
+    }
+  }
+
+  // had an exception escaped into a worker the program would have terminated
+  REQUIRE( calls >= 98 );
+}
+
+namespace
+{
+  /**
+   * A value which counts how often it has been copied.
+   */
+  struct CopyCounter
+  {
+    static int copies;
+
+    int data{ 0 };
+
+    CopyCounter() = default;
+    explicit CopyCounter(int value) : data(value) {  }
+    CopyCounter(const CopyCounter& other) : data(other.data) { copies++; }
+    CopyCounter(CopyCounter&&) = default;
+    CopyCounter& operator = (const CopyCounter& other) { data = other.data; copies++; return *this; }
+    CopyCounter& operator = (CopyCounter&&) = default;
+  };
+
+  int CopyCounter::copies = 0;
+}
+
+TEST_CASE("Watched writes which change nothing copy nothing", "[Watch]")
+{
+  Atom<CopyCounter> subject(CopyCounter(1), [](const CopyCounter& value){ return value.data > 0; });
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const CopyCounter& oldValue, const CopyCounter& newValue)
+  {
+    changes.emplace_back(oldValue.data, newValue.data);
+  });
+
+  CopyCounter::copies = 0;
+
+  REQUIRE( !subject.CompareAndSetVersion(subject.Version() + 1, CopyCounter(2)) );
+  REQUIRE( !subject.CompareAndSetVersion(subject.Version(), CopyCounter(-1)) );
+  REQUIRE( CopyCounter::copies == 0 );
+  REQUIRE( changes.empty() );
+
+  REQUIRE( subject.CompareAndSetVersion(subject.Version(), CopyCounter(2)) );
+  subject.Modify([](CopyCounter& value){ value.data++; });
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{ { 1, 2 }, { 2, 3 } }) );
+}
+
+TEST_CASE("Watchers of lock-free atoms are told about every successful write", "[Watch]")
+{
+  typedef Atom<int> AtomType;
+
+  REQUIRE( (std::is_same<AtomType, Atom<int, LockFree>>::value) );
+
+  AtomType subject(0, [](const int& newValue){ return newValue >= 0; });
+  std::vector<std::pair<int, int>> changes;
+
+  subject.AddWatch("log", [&](const int& oldValue, const int& newValue)
+  {
+    changes.emplace_back(oldValue, newValue);
+  });
+
+  subject.Reset(1);
+  REQUIRE( subject.CompareAndSet(1, 2) );
+  REQUIRE( !subject.CompareAndSet(1, 3) );
+  REQUIRE( !subject.CompareAndSet(2, -1) );
+  REQUIRE( subject.Exchange(3) == 2 );
+  subject.Swap([](const int& currentValue){ return currentValue + 1; });
+  subject.Reset([](const int& currentValue){ return currentValue + 1; });
+  subject.Reset([](const int&){ return -1; });
+  subject.Modify([](int& currentValue){ currentValue = 10; });
+
+  REQUIRE( (changes == std::vector<std::pair<int, int>>{
+    { 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 4 }, { 4, 5 }, { 5, 10 } }) );
+
+  REQUIRE( subject.RemoveWatch("log") );
+  subject.Reset(11);
+  REQUIRE( changes.size() == 6 );
+}
+
+TEST_CASE("Coalescing watchers of lock-free atoms see the newest value last", "[Watch]")
+{
+  typedef Atom<int> AtomType;
+
+  AtomType subject(0);
+  std::atomic<int> last{ -1 };
+
+  {
+    ThreadPoolExecutor executor(2);
+
+    subject.AddWatch("last", [&](const int&, const int& newValue)
+    {
+      last = newValue;
+    }, executor, WatchMode::Coalesce);
+
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 4; i++)
+    {
+      threads.emplace_back([&subject]()
+      {
+        for (int j = 0; j < 1000; j++)
+        {
+          subject.Swap([](const int& currentValue){ return currentValue + 1; });
+        }
+      });
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  }
+
+  REQUIRE( subject.Value() == 4000 );
+  REQUIRE( last == 4000 );
+}
@@ -0,0 +1,109 @@
+#include <catch.hh>
+#include <CachedReader.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("CachedReader refreshes after writes", "[CachedReader]")
+{
+  typedef Atom<std::string> AtomType;
+
+  AtomType subject{ std::string("foo") };
+  CachedReader<std::string> reader(subject);
+
+  REQUIRE( reader.Value() == "foo" );
+  REQUIRE( !reader.Stale() );
+
+  subject.Reset(std::string("bar"));
+  REQUIRE( reader.Stale() );
+  REQUIRE( reader.Value() == "bar" );
+  REQUIRE( reader.Version() == subject.Version() );
+
+  subject.Modify([](std::string& value){ value += "baz"; });
+  REQUIRE( reader.Value() == "barbaz" );
+
+  subject.Swap([](const std::string& value){ return value + "!"; });
+  REQUIRE( reader.Value() == "barbaz!" );
+}
+
+TEST_CASE("CachedReader does not copy unchanged values", "[CachedReader]")
+{
+  typedef Atom<std::string, ExclusiveLock, std::function<bool(const std::string&)>, AtomStats> AtomType;
+
+  AtomType subject{ std::string("foo") };
+  CachedReader<std::string, ExclusiveLock, std::function<bool(const std::string&)>, AtomStats> reader(subject);
+
+  subject.ClearStatistics();
+
+  for (int i = 0; i < 100; i++)
+  {
+    REQUIRE( reader.Value() == "foo" );
+  }
+
+  REQUIRE( subject.Statistics().copies == 0 );
+  REQUIRE( subject.Statistics().reads == 0 );
+
+  subject = std::string("bar");
+  REQUIRE( reader.Value() == "bar" );
+  REQUIRE( subject.Statistics().copies == 1 );
+}
+
+TEST_CASE("CachedReader with a SeqLock Atom", "[CachedReader]")
+{
+  typedef SeqLockAtom<uint64_t> AtomType;
+
+  AtomType subject(1);
+  CachedReader<uint64_t, SeqLock> reader(subject);
+
+  REQUIRE( reader.Value() == 1 );
+  subject.Reset(uint64_t(2));
+  REQUIRE( reader.Value() == 2 );
+}
+
+TEST_CASE("CachedReader per thread", "[CachedReader]")
+{
+  typedef Atom<std::vector<int>> AtomType;
+
+  const int readerCount = 3;
+  const int writes = 200;
+
+  AtomType subject{ std::vector<int>() };
+  std::atomic<bool> backwards{ false };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < readerCount; i++)
+  {
+    threads.emplace_back([&subject, &backwards]()
+    {
+      CachedReader<std::vector<int>> reader(subject);
+      size_t last{ 0 };
+
+      while (last < writes)
+      {
+        size_t size = reader.Value().size();
+
+        if (size < last)
+        {
+          backwards = true;
+        }
+
+        last = size;
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  for (int i = 0; i < writes; i++)
+  {
+    subject.Modify([](std::vector<int>& value){ value.push_back(0); });
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( !backwards );
+}
@@ -0,0 +1,82 @@
+#include <catch.hh>
+#include <Delay.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Delay computes its value on first access", "[Delay]")
+{
+  int calls{ 0 };
+  Delay<std::string> delay([&calls]() { calls++; return std::string("value"); });
+
+  REQUIRE( calls == 0 );
+  REQUIRE( !delay.IsRealized() );
+
+  REQUIRE( delay.Value() == "value" );
+  REQUIRE( delay.IsRealized() );
+  REQUIRE( &delay.Value() == &delay.Value() );
+  REQUIRE( calls == 1 );
+}
+
+TEST_CASE("Delay computes once when callers race", "[Delay]")
+{
+  std::atomic<int> calls{ 0 };
+  std::atomic<int> wrong{ 0 };
+
+  Delay<int> delay([&calls]()
+  {
+    calls++;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    return 42;
+  });
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < 8; i++)
+  {
+    threads.emplace_back([&]()
+    {
+      if (delay.Value() != 42)
+      {
+        wrong++;
+      }
+    });
+  }
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( calls == 1 );
+  REQUIRE( wrong == 0 );
+}
+
+TEST_CASE("Delay rethrows the exception of its function", "[Delay]")
+{
+  int calls{ 0 };
+  Delay<int> delay([&calls]() -> int { calls++; throw std::runtime_error("boom"); });
+
+  REQUIRE_THROWS_AS( delay.Value(), std::runtime_error& );
+  REQUIRE_THROWS_AS( delay.Value(), std::runtime_error& );
+  REQUIRE( delay.IsRealized() );
+  REQUIRE( calls == 1 );
+}
+
+TEST_CASE("Delay releases its function once realized", "[Delay]")
+{
+  auto captured = std::make_shared<int>(7);
+  std::weak_ptr<int> watch(captured);
+
+  auto func = [captured = std::move(captured)]() { return *captured; };
+  Delay<int, decltype(func)> delay(std::move(func));
+
+  REQUIRE( !watch.expired() );
+  REQUIRE( delay.Value() == 7 );
+  REQUIRE( watch.expired() );
+}
@@ -0,0 +1,264 @@
+#include <catch.hh>
+#include <Atom.h>
+#include <Future.h>
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  thread_local size_t tAllocations{ 0 };
+}
+
+// counts the allocations of the calling thread, see the Then() allocation test
+void* operator new(std::size_t size)
+{
+  tAllocations++;
+
+  if (void* memory = std::malloc(size == 0 ? 1 : size))
+  {
+    return memory;
+  }
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
+static_assert(std::is_nothrow_move_constructible<Promise<int>>::value,
+              "a Promise captured by a continuation must fit into an InlineCallback");
+static_assert(std::is_nothrow_move_constructible<Future<int>>::value,
+              "Future must be nothrow movable");
+
+TEST_CASE("Promise fulfills its future", "[Future]")
+{
+  Promise<int> promise;
+  Future<int> future = promise.GetFuture();
+
+  REQUIRE( !future.Ready() );
+  REQUIRE( !future.WaitFor(std::chrono::milliseconds(1)) );
+
+  promise.SetValue(42);
+
+  REQUIRE( future.Ready() );
+  REQUIRE( future.Fulfilled() );
+  REQUIRE( future.Get() == 42 );
+  REQUIRE( !promise.TrySetValue(43) );
+  REQUIRE_THROWS_AS( promise.SetValue(44), std::future_error& );
+  REQUIRE( future.Get() == 42 );
+}
+
+TEST_CASE("Future Get blocks until another thread fulfills it", "[Future]")
+{
+  Promise<std::string> promise;
+  Future<std::string> future = promise.GetFuture();
+
+  std::thread producer([promise]() mutable
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    promise.SetValue(std::string("done"));
+  });
+
+  REQUIRE( future.Get() == "done" );
+  producer.join();
+}
+
+TEST_CASE("Future Then chains transformations", "[Future]")
+{
+  Promise<int> promise;
+  std::vector<std::string> seen;
+
+  Future<std::string> result = promise.GetFuture()
+    .Then([](const int& value) { return value * 2; })
+    .Then([](const int& value) { return std::to_string(value); });
+
+  result.OnSuccess([&](const std::string& value) { seen.push_back(value); });
+
+  REQUIRE( !result.Ready() );
+
+  promise.SetValue(21);
+
+  REQUIRE( result.Get() == "42" );
+  REQUIRE( (seen == std::vector<std::string>{ "42" }) );
+
+  // callbacks added after resolution run immediately
+  result.OnSuccess([&](const std::string& value) { seen.push_back(value + "!"); });
+  REQUIRE( (seen == std::vector<std::string>{ "42", "42!" }) );
+}
+
+TEST_CASE("Future rejections skip Then and reach OnFailure", "[Future]")
+{
+  Promise<int> promise;
+  bool called{ false };
+  bool failed{ false };
+
+  Future<int> result = promise.GetFuture()
+    .Then([&](const int& value) { called = true; return value; });
+
+  result.OnSuccess([&](const int&) { called = true; })
+        .OnFailure([&](std::exception_ptr) { failed = true; });
+
+  promise.SetException(std::make_exception_ptr(std::runtime_error("boom")));
+
+  REQUIRE( !called );
+  REQUIRE( failed );
+  REQUIRE( result.Rejected() );
+  REQUIRE_THROWS_AS( result.Get(), std::runtime_error& );
+
+  Future<int> thrown = MakeFuture(1).Then([](const int&) -> int { throw std::logic_error("bad"); });
+  REQUIRE_THROWS_AS( thrown.Get(), std::logic_error& );
+}
+
+TEST_CASE("Future of a broken promise is rejected", "[Future]")
+{
+  Future<int> future = Promise<int>().GetFuture();
+
+  REQUIRE( future.Rejected() );
+  REQUIRE_THROWS_AS( future.Get(), std::future_error& );
+}
+
+TEST_CASE("Future resolves into an Atom", "[Future]")
+{
+  Atom<std::string> subject{ std::string("old") };
+  Promise<std::string> promise;
+
+  promise.GetFuture().ResolveInto(subject);
+  REQUIRE( subject.Value() == "old" );
+
+  promise.SetValue(std::string("new"));
+  REQUIRE( subject.Value() == "new" );
+}
+
+TEST_CASE("Future resolving into an Atom drops exceptions from the reset", "[Future]")
+{
+  Atom<std::string> subject(std::string("old"), [](const std::string& newValue) -> bool
+  {
+    throw std::invalid_argument(newValue);
+  });
+  Promise<std::string> promise;
+
+  promise.GetFuture().ResolveInto(subject);
+  promise.SetValue(std::string("new"));
+
+  REQUIRE( subject.Value() == "old" );
+}
+
+TEST_CASE("Async runs on the shared executor", "[Future]")
+{
+  std::thread::id caller = std::this_thread::get_id();
+
+  Future<bool> future = Async([caller]() { return std::this_thread::get_id() != caller; });
+  REQUIRE( future.Get() );
+
+  ThreadPoolExecutor executor(2);
+  Future<int> chained = Async([]() { return 20; }, executor)
+    .Then([](const int& value) { return value + 1; }, executor)
+    .Then([](const int& value) { return value * 2; });
+
+  REQUIRE( chained.Get() == 42 );
+}
+
+TEST_CASE("WhenAll collects every value in order", "[Future]")
+{
+  std::vector<Promise<int>> promises(3);
+  std::vector<Future<int>> futures;
+
+  for (Promise<int>& promise : promises)
+  {
+    futures.push_back(promise.GetFuture());
+  }
+
+  Future<std::vector<int>> all = WhenAll(futures);
+
+  promises[2].SetValue(3);
+  promises[0].SetValue(1);
+  REQUIRE( !all.Ready() );
+
+  promises[1].SetValue(2);
+  REQUIRE( (all.Get() == std::vector<int>{ 1, 2, 3 }) );
+
+  REQUIRE( WhenAll(std::vector<Future<int>>()).Get().empty() );
+
+  Promise<int> failing;
+  Future<std::vector<int>> rejected = WhenAll(std::vector<Future<int>>{ MakeFuture(1), failing.GetFuture() });
+  failing.SetException(std::make_exception_ptr(std::runtime_error("boom")));
+  REQUIRE_THROWS_AS( rejected.Get(), std::runtime_error& );
+}
+
+TEST_CASE("WhenAny takes the first value", "[Future]")
+{
+  Promise<int> slow;
+  Promise<int> failing;
+  Promise<int> fast;
+
+  Future<int> any = WhenAny(std::vector<Future<int>>{ slow.GetFuture(), failing.GetFuture(), fast.GetFuture() });
+
+  failing.SetException(std::make_exception_ptr(std::runtime_error("boom")));
+  REQUIRE( !any.Ready() );
+
+  fast.SetValue(2);
+  slow.SetValue(1);
+  REQUIRE( any.Get() == 2 );
+
+  Promise<int> only;
+  Future<int> rejected = WhenAny(std::vector<Future<int>>{ only.GetFuture() });
+  only.SetException(std::make_exception_ptr(std::runtime_error("boom")));
+  REQUIRE_THROWS_AS( rejected.Get(), std::runtime_error& );
+
+  REQUIRE_THROWS_AS( WhenAny(std::vector<Future<int>>()), std::invalid_argument& );
+}
+
+TEST_CASE("InlineCallback stores small callables inline", "[Future]")
+{
+  int calls{ 0 };
+  InlineCallback<int> small;
+  InlineCallback<int> large;
+
+  std::vector<int> captured(100, 1);
+
+  small.Set([&calls](int value) { calls += value; });
+  large.Set([&calls, captured, padding = std::array<char, 64>()](int value) { calls += value * captured[0]; });
+
+  small(1);
+  large(2);
+  REQUIRE( calls == 3 );
+
+  small.Reset();
+  REQUIRE( small.Empty() );
+  REQUIRE( !large.Empty() );
+}
+
+TEST_CASE("Future Then allocates once per pending stage", "[Future]")
+{
+  Promise<int> promise;
+  Future<int> future = promise.GetFuture();
+
+  size_t before = tAllocations;
+
+  Future<int> result = future
+    .Then([](const int& value) { return value + 1; })
+    .Then([](const int& value) { return value * 2; })
+    .Then([](const int& value) { return value - 1; });
+
+  size_t allocations = tAllocations - before;
+
+  REQUIRE( allocations == 3 );
+
+  promise.SetValue(1);
+  REQUIRE( result.Get() == 3 );
+}
@@ -0,0 +1,378 @@
+#include <catch.hh>
+#include <Atom.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  struct Pair
+  {
+    uint64_t first;
+    uint64_t second;
+
+    bool operator == (const Pair& other) const
+    {
+      return first == other.first && second == other.second;
+    }
+  };
+
+  /**
+   * Runs writers which keep both halves of the pair equal against readers
+   * which verify that they never observe a torn pair.
+   */
+  template<typename LockPolicy>
+  void requireConsistentUnderContention()
+  {
+    typedef Atom<Pair, LockPolicy> AtomType;
+
+    const int writerCount = 2;
+    const int readerCount = 2;
+    const int iterations = 5000;
+
+    AtomType subject(Pair{ 0, 0 });
+    std::atomic<bool> torn{ false };
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < writerCount; i++)
+    {
+      threads.emplace_back([&subject]()
+      {
+        for (int j = 0; j < iterations; j++)
+        {
+          subject.Modify([](Pair& currentValue)
+                         {
+                           currentValue.first++;
+                           currentValue.second++;
+                         });
+        }
+      });
+    }
+
+    for (int i = 0; i < readerCount; i++)
+    {
+      threads.emplace_back([&subject, &torn]()
+      {
+        for (int j = 0; j < iterations; j++)
+        {
+          Pair value = subject.Value();
+
+          if (value.first != value.second)
+          {
+            torn = true;
+          }
+        }
+      });
+    }
+
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+
+    REQUIRE( !torn );
+    REQUIRE( subject.Value().first == writerCount * iterations );
+  }
+
+  template<typename LockPolicy>
+  void requireBasicOperations()
+  {
+    typedef std::pair<std::string, uint64_t> ValueType;
+    typedef Atom<ValueType, LockPolicy> AtomType;
+
+    AtomType subject(ValueType("foo", 0));
+
+    REQUIRE( subject.CompareAndSet(ValueType("foo", 0), ValueType("bar", 1)) );
+    REQUIRE( subject == ValueType("bar", 1) );
+
+    subject.Swap([](const ValueType& currentValue)
+                 { return ValueType(currentValue.first, currentValue.second + 1); });
+    REQUIRE( subject.Value().second == 2 );
+
+    uint64_t actual{ 0 };
+    subject.With([&actual](const ValueType& currentValue)
+                 { actual = currentValue.second; });
+    REQUIRE( actual == 2 );
+  }
+}
+
+TEST_CASE("SpinMutex", "[LockPolicy]")
+{
+  SpinMutex subject;
+
+  REQUIRE( subject.try_lock() );
+  REQUIRE( !subject.try_lock() );
+  subject.unlock();
+  REQUIRE( subject.try_lock() );
+  subject.unlock();
+}
+
+TEST_CASE("AdaptiveMutex", "[LockPolicy]")
+{
+  AdaptiveMutex subject;
+
+  subject.lock();
+  REQUIRE( !subject.try_lock() );
+  subject.unlock();
+  REQUIRE( subject.try_lock() );
+  subject.unlock();
+}
+
+TEST_CASE("Default lock policy", "[LockPolicy]")
+{
+  REQUIRE( (std::is_same<DefaultLockPolicy<uint64_t>, LockFree>::value) );
+  REQUIRE( (std::is_same<DefaultLockPolicy<std::string>, ExclusiveLock>::value) );
+}
+
+TEST_CASE("ExclusiveLock", "[LockPolicy]")
+{
+  requireBasicOperations<ExclusiveLock>();
+  requireConsistentUnderContention<ExclusiveLock>();
+}
+
+TEST_CASE("SharedLock", "[LockPolicy]")
+{
+  requireBasicOperations<SharedLock>();
+  requireConsistentUnderContention<SharedLock>();
+}
+
+TEST_CASE("SpinLock", "[LockPolicy]")
+{
+  requireBasicOperations<SpinLock>();
+  requireConsistentUnderContention<SpinLock>();
+}
+
+TEST_CASE("AdaptiveLock", "[LockPolicy]")
+{
+  requireBasicOperations<AdaptiveLock>();
+  requireConsistentUnderContention<AdaptiveLock>();
+}
+
+TEST_CASE("SeqLock", "[LockPolicy]")
+{
+  requireConsistentUnderContention<SeqLock>();
+}
+
+TEST_CASE("SeqLockAtom with a large struct", "[LockPolicy]")
+{
+  struct Config
+  {
+    uint64_t fields[32];
+  };
+
+  typedef SeqLockAtom<Config> AtomType;
+
+  Config initial{};
+  AtomType subject(initial);
+
+  const int iterations = 2000;
+  std::atomic<bool> torn{ false };
+
+  std::thread writer([&subject]()
+  {
+    for (int i = 1; i <= iterations; i++)
+    {
+      Config next{};
+      for (auto& field : next.fields)
+      {
+        field = i;
+      }
+      subject = next;
+    }
+  });
+
+  std::thread reader([&subject, &torn]()
+  {
+    for (int i = 0; i < iterations; i++)
+    {
+      subject.With([&torn](const Config& currentValue)
+      {
+        for (auto field : currentValue.fields)
+        {
+          if (field != currentValue.fields[0])
+          {
+            torn = true;
+          }
+        }
+      });
+    }
+  });
+
+  writer.join();
+  reader.join();
+
+  REQUIRE( !torn );
+  REQUIRE( subject.Value().fields[31] == iterations );
+}
+
+TEST_CASE("SeqLockAtom readers proceed during a long update", "[LockPolicy]")
+{
+  typedef SeqLockAtom<Pair> AtomType;
+
+  AtomType subject(Pair{ 0, 0 });
+  std::atomic<bool> started{ false };
+  std::atomic<bool> readerDone{ false };
+
+  std::thread writer([&]()
+  {
+    subject.Reset([&](const Pair& currentValue)
+    {
+      started = true;
+      while (!readerDone)
+      {
+        std::this_thread::yield();
+      }
+      return Pair{ currentValue.first + 1, currentValue.second + 1 };
+    });
+  });
+
+  while (!started)
+  {
+    std::this_thread::yield();
+  }
+
+  // the writer is still inside its update function
+  Pair actual = subject.Value();
+  readerDone = true;
+  writer.join();
+
+  REQUIRE( actual.first == 0 );
+  REQUIRE( subject.Value().first == 1 );
+}
+
+TEST_CASE("FlatCombining", "[LockPolicy]")
+{
+  requireBasicOperations<FlatCombining>();
+  requireConsistentUnderContention<FlatCombining>();
+}
+
+TEST_CASE("FlatCombining applies every update exactly once", "[LockPolicy]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef Atom<ValueType, FlatCombining> AtomType;
+
+  const int threadCount = 8;
+  const int iterations = 2000;
+
+  AtomType subject{ ValueType(threadCount, 0) };
+  std::atomic<bool> lost{ false };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject, &lost, i]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        ValueType actual = subject.Reset([i](const ValueType& currentValue)
+                                         {
+                                           ValueType newValue(currentValue);
+                                           newValue[i]++;
+                                           return newValue;
+                                         });
+        if (actual[i] != uint64_t(j + 1))
+        {
+          lost = true;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( !lost );
+
+  for (auto count : subject.Value())
+  {
+    REQUIRE( count == iterations );
+  }
+  REQUIRE( subject.Version() == threadCount * iterations );
+}
+
+TEST_CASE("FlatCombining hands exceptions back to the writer", "[LockPolicy]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, FlatCombining> AtomType;
+
+  AtomType subject(1);
+
+  REQUIRE_THROWS_AS( subject.Modify([](ValueType&){ throw std::runtime_error("boom"); }),
+                     std::runtime_error& );
+  REQUIRE( subject.Reset(2) == 2 );
+}
+
+TEST_CASE("LeftRight", "[LockPolicy]")
+{
+  requireBasicOperations<LeftRight>();
+  requireConsistentUnderContention<LeftRight>();
+}
+
+TEST_CASE("LeftRight readers do not wait for writers", "[LockPolicy]")
+{
+  typedef std::string ValueType;
+  typedef LeftRightAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType("foo"));
+  std::atomic<bool> writing{ false };
+  std::atomic<bool> read{ false };
+  ValueType seen;
+
+  std::thread writer([&]()
+  {
+    subject.Reset([&](const ValueType& currentValue)
+    {
+      writing = true;
+
+      // hold the write lock until a reader got through, or give up
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+      while (!read && std::chrono::steady_clock::now() < deadline)
+      {
+        std::this_thread::yield();
+      }
+
+      return currentValue + "bar";
+    });
+  });
+
+  while (!writing)
+  {
+    std::this_thread::yield();
+  }
+
+  seen = subject.Value();
+  read = true;
+  writer.join();
+
+  REQUIRE( seen == "foo" );
+  REQUIRE( subject.Value() == "foobar" );
+  REQUIRE( subject.Version() == 1 );
+}
+
+TEST_CASE("LeftRight restores the value when a writer throws", "[LockPolicy]")
+{
+  typedef std::vector<int> ValueType;
+  typedef LeftRightAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1 });
+
+  REQUIRE_THROWS_AS( subject.Modify([](ValueType& value)
+                                    {
+                                      value.push_back(2);
+                                      throw std::runtime_error("boom");
+                                    }),
+                     std::runtime_error& );
+  REQUIRE( subject.Value() == ValueType{ 1 } );
+
+  subject.Modify([](ValueType& value){ value.push_back(3); });
+  REQUIRE( (subject.Value() == ValueType{ 1, 3 }) );
+  subject.Modify([](ValueType& value){ value.push_back(4); });
+  REQUIRE( (subject.Value() == ValueType{ 1, 3, 4 }) );
+}
@@ -0,0 +1,216 @@
+#include <catch.hh>
+#include <MultiAtom.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+TEST_CASE("ResetMany", "[MultiAtom]")
+{
+  typedef int64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AccountType;
+  typedef Atom<std::vector<std::string>, SharedLock> LogType;
+
+  auto nonNegative = [](const ValueType& newValue){ return newValue >= 0; };
+
+  AccountType from(100, nonNegative);
+  AccountType to(0, nonNegative);
+  LogType log{ std::vector<std::string>() };
+
+  auto transfer = [](ValueType amount)
+  {
+    return [amount](const ValueType& fromValue, const ValueType& toValue,
+                    const std::vector<std::string>& logValue)
+    {
+      std::vector<std::string> newLog(logValue);
+      newLog.push_back(std::to_string(amount));
+      return std::make_tuple(fromValue - amount, toValue + amount, newLog);
+    };
+  };
+
+  REQUIRE( ResetMany(transfer(60), from, to, log) );
+  REQUIRE( from.Value() == 40 );
+  REQUIRE( to.Value() == 60 );
+  REQUIRE( log.Value().size() == 1 );
+
+  // would overdraw the account: nothing changes
+  REQUIRE( !ResetMany(transfer(60), from, to, log) );
+  REQUIRE( from.Value() == 40 );
+  REQUIRE( to.Value() == 60 );
+  REQUIRE( log.Value().size() == 1 );
+}
+
+TEST_CASE("SwapMany", "[MultiAtom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, SpinLock> AtomType;
+
+  AtomType first(1);
+  AtomType second(2);
+
+  REQUIRE( SwapMany([](const ValueType& a, const ValueType& b)
+                    { return std::make_tuple(b, a); }, first, second) );
+  REQUIRE( first.Value() == 2 );
+  REQUIRE( second.Value() == 1 );
+  REQUIRE( first.Version() == 1 );
+}
+
+TEST_CASE("ResetMany rejects the same atom twice", "[MultiAtom]")
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+
+  AtomType subject(1);
+
+  REQUIRE_THROWS_AS( ResetMany([](const ValueType& a, const ValueType& b)
+                               { return std::make_tuple(a, b); }, subject, subject),
+                     std::invalid_argument& );
+}
+
+TEST_CASE("ResetMany and SwapMany keep a sum constant under contention", "[MultiAtom]")
+{
+  typedef int64_t ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+
+  const int threadCount = 4;
+  const int iterations = 2000;
+
+  AtomType first(1000);
+  AtomType second(1000);
+  std::atomic<bool> inconsistent{ false };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&, i]()
+    {
+      auto move = [](const ValueType& a, const ValueType& b)
+                  { return std::make_tuple(a - 1, b + 1); };
+
+      for (int j = 0; j < iterations; j++)
+      {
+        // alternate the argument order to provoke lock order inversions
+        if (i % 2 == 0)
+        {
+          ResetMany(move, first, second);
+        }
+        else
+        {
+          SwapMany(move, second, first);
+        }
+
+        ResetMany([&inconsistent](const ValueType& a, const ValueType& b)
+                  {
+                    if (a + b != 2000)
+                    {
+                      inconsistent = true;
+                    }
+                    return std::make_tuple(a, b);
+                  }, second, first);
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( !inconsistent );
+  REQUIRE( first.Value() + second.Value() == 2000 );
+}
+
+template<typename LockPolicy>
+static int countTornReads()
+{
+  typedef uint64_t ValueType;
+  typedef Atom<ValueType, LockPolicy> AtomType;
+
+  const ValueType iterations = 5000;
+
+  AtomType first(0);
+  AtomType second(0);
+  std::atomic<bool> done{ false };
+  int torn = 0;
+
+  std::thread writer([&]()
+  {
+    for (ValueType i = 0; i < iterations; i++)
+    {
+      ResetMany([](const ValueType& a, const ValueType& b)
+                { return std::make_tuple(a + 1, b + 1); }, first, second);
+    }
+
+    done = true;
+  });
+
+  // both values only grow, so the one read last may never be behind
+  while (!done)
+  {
+    ValueType firstValue = first.Value();
+    ValueType secondValue = second.Value();
+
+    if (secondValue < firstValue)
+    {
+      torn++;
+    }
+
+    secondValue = second.Value();
+    firstValue = first.Value();
+
+    if (firstValue < secondValue)
+    {
+      torn++;
+    }
+  }
+
+  writer.join();
+
+  return torn;
+}
+
+TEST_CASE("ResetMany is never seen half done", "[MultiAtom]")
+{
+  REQUIRE( countTornReads<ExclusiveLock>() == 0 );
+  REQUIRE( countTornReads<SharedLock>() == 0 );
+  REQUIRE( countTornReads<SpinLock>() == 0 );
+  REQUIRE( countTornReads<AdaptiveLock>() == 0 );
+  REQUIRE( countTornReads<FlatCombining>() == 0 );
+
+  // readers of these never wait, so MultiAtom refuses them
+  REQUIRE( !ReadersWaitForWriters<SeqLock>::value );
+  REQUIRE( !ReadersWaitForWriters<LeftRight>::value );
+  REQUIRE( !ReadersWaitForWriters<LockFree>::value );
+}
+
+TEST_CASE("ResetMany and SwapMany call watchers once every atom is unlocked", "[MultiAtom]")
+{
+  typedef std::string ValueType;
+  typedef Atom<ValueType, ExclusiveLock> AtomType;
+
+  AtomType first{ ValueType("a") };
+  AtomType second{ ValueType("b") };
+  std::vector<std::string> seen;
+
+  // each watcher reads the other atom, which would deadlock under its lock
+  first.AddWatch("other", [&](const ValueType&, const ValueType& newValue)
+  {
+    seen.push_back(newValue + second.Value());
+  });
+
+  second.AddWatch("other", [&](const ValueType&, const ValueType& newValue)
+  {
+    seen.push_back(first.Value() + newValue);
+  });
+
+  REQUIRE( ResetMany([](const ValueType& a, const ValueType& b)
+                     { return std::make_tuple(a + "1", b + "1"); }, first, second) );
+
+  REQUIRE( SwapMany([](const ValueType& a, const ValueType& b)
+                    { return std::make_tuple(a + "2", b + "2"); }, second, first) );
+
+  REQUIRE( (seen == std::vector<std::string>{ "a1b1", "a1b1", "a12b12", "a12b12" }) );
+}
@@ -0,0 +1,169 @@
+#include <catch.hh>
+#include <Atom.h>
+#include <PersistentMap.h>
+#include <PersistentSet.h>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+  /**
+   * A terrible hash function which forces plenty of collisions.
+   */
+  struct CollidingHash
+  {
+    size_t operator () (uint64_t key) const
+    {
+      return key % 7;
+    }
+  };
+}
+
+TEST_CASE("PersistentMap initialization", "[PersistentMap]")
+{
+  typedef PersistentMap<std::string, uint64_t> MapType;
+
+  MapType empty;
+  REQUIRE( empty.Empty() );
+  REQUIRE( empty.Find("foo") == nullptr );
+
+  MapType subject{ { "foo", 1 }, { "bar", 2 }, { "foo", 3 } };
+  REQUIRE( subject.Size() == 2 );
+  REQUIRE( subject.At("foo") == 3 );
+  REQUIRE( subject.Contains("bar") );
+  REQUIRE( !subject.Contains("baz") );
+  REQUIRE_THROWS_AS( subject.At("baz"), std::out_of_range& );
+}
+
+TEST_CASE("PersistentMap Set and Erase", "[PersistentMap]")
+{
+  typedef PersistentMap<uint64_t, uint64_t> MapType;
+
+  const uint64_t count = 20000;
+
+  MapType subject;
+  std::map<uint64_t, uint64_t> expected;
+
+  for (uint64_t i = 0; i < count; i++)
+  {
+    uint64_t key = i * 2654435761u;
+    subject = subject.Set(key, i);
+    expected[key] = i;
+  }
+
+  MapType snapshot = subject;
+
+  for (uint64_t i = 0; i < count; i += 3)
+  {
+    uint64_t key = i * 2654435761u;
+    subject = subject.Erase(key);
+    expected.erase(key);
+  }
+
+  REQUIRE( subject.Size() == expected.size() );
+  REQUIRE( snapshot.Size() == count );
+
+  bool matches{ true };
+  size_t visited{ 0 };
+
+  subject.ForEach([&](const uint64_t& key, const uint64_t& value)
+  {
+    matches = matches && expected.count(key) == 1 && expected[key] == value;
+    visited++;
+  });
+
+  REQUIRE( matches );
+  REQUIRE( visited == expected.size() );
+  REQUIRE( snapshot.At(0) == 0 );
+  REQUIRE( !subject.Contains(0) );
+}
+
+TEST_CASE("PersistentMap with colliding hashes", "[PersistentMap]")
+{
+  typedef PersistentMap<uint64_t, std::string, CollidingHash> MapType;
+
+  MapType subject;
+
+  for (uint64_t i = 0; i < 100; i++)
+  {
+    subject = subject.Set(i, std::to_string(i));
+  }
+
+  REQUIRE( subject.Size() == 100 );
+  REQUIRE( subject.At(42) == "42" );
+
+  subject = subject.Set(42, "answer");
+  REQUIRE( subject.Size() == 100 );
+  REQUIRE( subject.At(42) == "answer" );
+
+  for (uint64_t i = 0; i < 100; i += 2)
+  {
+    subject = subject.Erase(i);
+  }
+
+  REQUIRE( subject.Size() == 50 );
+  REQUIRE( !subject.Contains(42) );
+  REQUIRE( subject.At(43) == "43" );
+
+  for (uint64_t i = 1; i < 100; i += 2)
+  {
+    subject = subject.Erase(i);
+  }
+
+  REQUIRE( subject.Empty() );
+}
+
+TEST_CASE("PersistentMap equality", "[PersistentMap]")
+{
+  typedef PersistentMap<std::string, uint64_t> MapType;
+
+  MapType subject{ { "foo", 1 }, { "bar", 2 } };
+  MapType copy(subject);
+  MapType rebuilt{ { "bar", 2 }, { "foo", 1 } };
+
+  REQUIRE( subject == copy );
+  REQUIRE( subject == rebuilt );
+  REQUIRE( subject != subject.Set("foo", 3) );
+  REQUIRE( subject != subject.Erase("foo") );
+  REQUIRE( subject.Erase("baz") == subject );
+}
+
+TEST_CASE("PersistentMap inside an Atom", "[PersistentMap]")
+{
+  typedef PersistentMap<std::string, uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject{ ValueType() };
+
+  subject.Swap([](const ValueType& currentValue)
+               { return currentValue.Set("hits", 1); });
+  subject.Swap([](const ValueType& currentValue)
+               { return currentValue.Set("hits", currentValue.At("hits") + 1); });
+
+  REQUIRE( subject.Value().At("hits") == 2 );
+}
+
+TEST_CASE("PersistentSet", "[PersistentMap]")
+{
+  typedef PersistentSet<std::string> SetType;
+
+  SetType subject{ "foo", "bar" };
+
+  REQUIRE( subject.Size() == 2 );
+  REQUIRE( subject.Contains("foo") );
+
+  SetType changed = subject.Insert("baz").Erase("foo");
+  REQUIRE( changed.Size() == 2 );
+  REQUIRE( changed.Contains("baz") );
+  REQUIRE( !changed.Contains("foo") );
+  REQUIRE( subject.Contains("foo") );
+
+  size_t count{ 0 };
+  changed.ForEach([&count](const std::string&){ count++; });
+  REQUIRE( count == 2 );
+
+  REQUIRE( (subject == SetType{ "bar", "foo" }) );
+  REQUIRE( subject != changed );
+}
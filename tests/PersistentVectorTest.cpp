@@ -0,0 +1,108 @@
+#include <catch.hh>
+#include <Atom.h>
+#include <PersistentVector.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("PersistentVector initialization", "[PersistentVector]")
+{
+  typedef PersistentVector<std::string> VectorType;
+
+  VectorType empty;
+  REQUIRE( empty.Empty() );
+  REQUIRE( empty.Size() == 0 );
+
+  VectorType subject{ "foo", "bar" };
+  REQUIRE( subject.Size() == 2 );
+  REQUIRE( subject[0] == "foo" );
+  REQUIRE( subject.At(1) == "bar" );
+  REQUIRE_THROWS_AS( subject.At(2), std::out_of_range& );
+}
+
+TEST_CASE("PersistentVector PushBack, Set and PopBack", "[PersistentVector]")
+{
+  typedef PersistentVector<uint64_t> VectorType;
+
+  // enough values to need a trie three levels deep
+  const uint64_t count = 40000;
+
+  VectorType subject;
+  std::vector<VectorType> versions;
+
+  for (uint64_t i = 0; i < count; i++)
+  {
+    subject = subject.PushBack(i);
+
+    if (i % 1000 == 0)
+    {
+      versions.push_back(subject);
+    }
+  }
+
+  REQUIRE( subject.Size() == count );
+
+  bool matches{ true };
+  uint64_t expected{ 0 };
+
+  for (uint64_t value : subject)
+  {
+    matches = matches && value == expected++;
+  }
+  REQUIRE( matches );
+
+  // older versions are unaffected
+  for (size_t i = 0; i < versions.size(); i++)
+  {
+    REQUIRE( versions[i].Size() == i * 1000 + 1 );
+    REQUIRE( versions[i][i * 1000] == i * 1000 );
+  }
+
+  VectorType changed = subject.Set(5, 500).Set(count - 1, 0);
+  REQUIRE( changed[5] == 500 );
+  REQUIRE( changed[count - 1] == 0 );
+  REQUIRE( subject[5] == 5 );
+  REQUIRE( subject[count - 1] == count - 1 );
+
+  for (uint64_t i = count; i > 0; i--)
+  {
+    REQUIRE( subject.Size() == i );
+    REQUIRE( subject[i - 1] == i - 1 );
+    subject = subject.PopBack();
+  }
+
+  REQUIRE( subject.Empty() );
+  REQUIRE_THROWS_AS( subject.PopBack(), std::out_of_range& );
+}
+
+TEST_CASE("PersistentVector equality", "[PersistentVector]")
+{
+  typedef PersistentVector<uint64_t> VectorType;
+
+  VectorType subject{ 1, 2, 3 };
+  VectorType copy(subject);
+  VectorType rebuilt{ 1, 2, 3 };
+
+  REQUIRE( subject == copy );
+  REQUIRE( subject == rebuilt );
+  REQUIRE( subject != subject.Set(0, 0) );
+  REQUIRE( subject != subject.PushBack(4) );
+}
+
+TEST_CASE("PersistentVector inside an Atom", "[PersistentVector]")
+{
+  typedef PersistentVector<uint64_t> ValueType;
+  typedef Atom<ValueType> AtomType;
+
+  AtomType subject{ ValueType() };
+
+  for (uint64_t i = 0; i < 100; i++)
+  {
+    subject.Swap([i](const ValueType& currentValue)
+                 { return currentValue.PushBack(i); });
+  }
+
+  REQUIRE( subject.Value().Size() == 100 );
+  REQUIRE( subject.Value()[99] == 99 );
+}
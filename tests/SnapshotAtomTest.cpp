@@ -0,0 +1,153 @@
+#include <catch.hh>
+#include <SnapshotAtom.h>
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST_CASE("SnapshotAtom initialization", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  ValueType initial{ 1, 2, 3 };
+  AtomType subject(initial);
+
+  REQUIRE( *subject.Value() == initial );
+  REQUIRE( subject == initial );
+  REQUIRE( subject != ValueType() );
+}
+
+TEST_CASE("SnapshotAtom snapshots are stable", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1, 2, 3 });
+
+  AtomType::Snapshot before = subject.Value();
+  REQUIRE( subject.Value() == before );
+
+  subject = ValueType{ 4 };
+
+  REQUIRE( before->size() == 3 );
+  REQUIRE( subject.Value()->size() == 1 );
+}
+
+TEST_CASE("SnapshotAtom CompareAndSet compares snapshots", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1 });
+  AtomType::Snapshot current = subject.Value();
+
+  REQUIRE( subject.CompareAndSet(current, ValueType{ 2 }) );
+  REQUIRE( *subject.Value() == ValueType{ 2 } );
+
+  // same contents, but no longer the current snapshot
+  REQUIRE( !subject.CompareAndSet(current, ValueType{ 3 }) );
+  REQUIRE( *subject.Value() == ValueType{ 2 } );
+}
+
+TEST_CASE("SnapshotAtom Reset (with validation)", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType(), [](const ValueType& newValue){ return newValue.size() < 2; });
+
+  REQUIRE( *subject.Reset(ValueType{ 1 }) == ValueType{ 1 } );
+  REQUIRE( *subject.Reset(ValueType{ 1, 2 }) == ValueType{ 1 } );
+
+  AtomType::Snapshot actual = subject.Reset(
+      [](const ValueType& currentValue)
+      { return ValueType{ currentValue[0] + 1 }; });
+  REQUIRE( *actual == ValueType{ 2 } );
+}
+
+TEST_CASE("SnapshotAtom Swap, With and Modify", "[SnapshotAtom]")
+{
+  typedef std::map<std::string, uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ { "foo", 1 } });
+
+  subject.Swap([](const ValueType& currentValue)
+               {
+                 ValueType newValue(currentValue);
+                 newValue["bar"] = 2;
+                 return newValue;
+               });
+
+  uint64_t actual{ 0 };
+  subject.With([&actual](const ValueType& currentValue)
+               { actual = currentValue.at("bar"); });
+  REQUIRE( actual == 2 );
+
+  AtomType::Snapshot modified = subject.Modify(
+      [](ValueType& currentValue)
+      { currentValue.erase("foo"); });
+  REQUIRE( modified->size() == 1 );
+  REQUIRE( subject.Value() == modified );
+}
+
+TEST_CASE("SnapshotAtom Swap (concurrent)", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  const int threadCount = 4;
+  const int iterations = 1000;
+
+  AtomType subject{ ValueType() };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject, i]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        subject.Swap([i](const ValueType& currentValue)
+                     {
+                       ValueType newValue(currentValue);
+                       newValue.push_back(i);
+                       return newValue;
+                     });
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( subject.Value()->size() == threadCount * iterations );
+}
+
+TEST_CASE("SnapshotAtom Swap (with backoff)", "[SnapshotAtom]")
+{
+  typedef std::vector<uint64_t> ValueType;
+  typedef SnapshotAtom<ValueType> AtomType;
+
+  AtomType subject(ValueType{ 1 }, [](const ValueType& newValue){ return newValue.size() < 2; });
+
+  std::vector<int> backoffs;
+  auto backoff = [&backoffs](int attempts){ backoffs.push_back(attempts); };
+
+  AtomType::Snapshot actual = subject.Swap([](const ValueType& currentValue)
+                                           {
+                                             ValueType newValue(currentValue);
+                                             newValue.push_back(2);
+                                             return newValue;
+                                           }, backoff, 3);
+
+  REQUIRE( *actual == ValueType{ 1 } );
+  REQUIRE( (backoffs == std::vector<int>{ 1, 2 }) );
+
+  actual = subject.Swap([](const ValueType&){ return ValueType{ 3 }; }, YieldBackoff());
+  REQUIRE( *actual == ValueType{ 3 } );
+}
@@ -0,0 +1,79 @@
+#include <catch.hh>
+#include <StripedAtom.h>
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("StripedAtom initialization", "[StripedAtom]")
+{
+  typedef uint64_t ValueType;
+  typedef StripedAtom<ValueType> AtomType;
+
+  AtomType subject(42, 3);
+
+  REQUIRE( subject.Value() == 42 );
+  REQUIRE( subject.Stripes() == 4 );
+}
+
+TEST_CASE("StripedAtom Add, Increment and Decrement", "[StripedAtom]")
+{
+  typedef int64_t ValueType;
+  typedef StripedAtom<ValueType> AtomType;
+
+  AtomType subject;
+
+  subject.Add(10);
+  subject.Increment();
+  subject.Decrement();
+  subject.Decrement();
+  subject += 5;
+  subject -= 2;
+
+  REQUIRE( subject.Value() == 12 );
+}
+
+TEST_CASE("StripedAtom Reset and SumThenReset", "[StripedAtom]")
+{
+  typedef double ValueType;
+  typedef StripedAtom<ValueType> AtomType;
+
+  AtomType subject(1.5);
+  subject.Add(2.5);
+
+  REQUIRE( subject.SumThenReset() == 4.0 );
+  REQUIRE( subject.Value() == 0.0 );
+
+  subject = 7.0;
+  REQUIRE( subject.Value() == 7.0 );
+  REQUIRE( subject.Reset(3.0) == 3.0 );
+  REQUIRE( subject.Value() == 3.0 );
+}
+
+TEST_CASE("StripedAtom concurrent increments", "[StripedAtom]")
+{
+  typedef Adder<> AtomType;
+
+  const int threadCount = 8;
+  const int iterations = 10000;
+
+  AtomType subject;
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < threadCount; i++)
+  {
+    threads.emplace_back([&subject]()
+    {
+      for (int j = 0; j < iterations; j++)
+      {
+        subject.Increment();
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+
+  REQUIRE( subject.Value() == threadCount * iterations );
+}
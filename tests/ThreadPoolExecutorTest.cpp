@@ -0,0 +1,170 @@
+#include <catch.hh>
+#include <Atom.h>
+#include <ThreadPoolExecutor.h>
+#include <WorkStealingDeque.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+TEST_CASE("WorkStealingDeque pops newest and steals oldest", "[ThreadPoolExecutor]")
+{
+  WorkStealingDeque<int> deque(2);
+  int item{ 0 };
+
+  REQUIRE( deque.Empty() );
+  REQUIRE( !deque.Pop(item) );
+  REQUIRE( !deque.Steal(item) );
+
+  // more than the initial capacity, so the buffer grows
+  for (int i = 0; i < 10; i++)
+  {
+    deque.Push(i);
+  }
+
+  REQUIRE( !deque.Empty() );
+  REQUIRE( (deque.Pop(item) && item == 9) );
+  REQUIRE( (deque.Steal(item) && item == 0) );
+  REQUIRE( (deque.Steal(item) && item == 1) );
+  REQUIRE( (deque.Pop(item) && item == 8) );
+
+  int count{ 0 };
+
+  while (deque.Pop(item))
+  {
+    count++;
+  }
+
+  REQUIRE( count == 6 );
+  REQUIRE( deque.Empty() );
+}
+
+TEST_CASE("WorkStealingDeque hands every item out exactly once", "[ThreadPoolExecutor]")
+{
+  const int items = 20000;
+  const int thieves = 3;
+
+  WorkStealingDeque<int> deque;
+  std::vector<std::atomic<int>> taken(items);
+  std::atomic<bool> done{ false };
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < thieves; i++)
+  {
+    threads.emplace_back([&]()
+    {
+      int item{ 0 };
+
+      while (!done || !deque.Empty())
+      {
+        if (deque.Steal(item))
+        {
+          taken[item]++;
+        }
+      }
+    });
+  }
+
+  int item{ 0 };
+
+  for (int i = 0; i < items; i++)
+  {
+    deque.Push(i);
+
+    if (i % 3 == 0 && deque.Pop(item))
+    {
+      taken[item]++;
+    }
+  }
+
+  while (deque.Pop(item))
+  {
+    taken[item]++;
+  }
+
+  done = true;
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  int wrong{ 0 };
+
+  for (std::atomic<int>& count : taken)
+  {
+    if (count != 1)
+    {
+      wrong++;
+    }
+  }
+
+  REQUIRE( wrong == 0 );
+}
+
+TEST_CASE("ThreadPoolExecutor runs every task", "[ThreadPoolExecutor]")
+{
+  ThreadPoolExecutor executor(4);
+  Atom<int> done{ 0 };
+
+  REQUIRE( executor.WorkerCount() == 4 );
+
+  for (int i = 0; i < 1000; i++)
+  {
+    executor.Execute([&done]() { done.Swap([](const int& value){ return value + 1; }); });
+  }
+
+  REQUIRE( done.WaitUntil([](const int& value){ return value == 1000; }) == 1000 );
+}
+
+TEST_CASE("ThreadPoolExecutor runs tasks submitted by tasks", "[ThreadPoolExecutor]")
+{
+  ThreadPoolExecutor executor(3);
+  Atom<int> done{ 0 };
+
+  // a binary tree of tasks, all but the root submitted by workers
+  std::function<void(int)> spawn = [&](int depth)
+  {
+    done.Swap([](const int& value){ return value + 1; });
+
+    if (depth > 0)
+    {
+      executor.Execute([&spawn, depth]() { spawn(depth - 1); });
+      executor.Execute([&spawn, depth]() { spawn(depth - 1); });
+    }
+  };
+
+  executor.Execute([&spawn]() { spawn(9); });
+
+  REQUIRE( done.WaitUntil([](const int& value){ return value == 1023; }) == 1023 );
+}
+
+TEST_CASE("ThreadPoolExecutor finishes queued tasks before it is destroyed", "[ThreadPoolExecutor]")
+{
+  std::atomic<int> done{ 0 };
+
+  {
+    ThreadPoolExecutor executor(2);
+
+    for (int i = 0; i < 100; i++)
+    {
+      executor.Execute([&]()
+      {
+        done++;
+        executor.Execute([&]() { done++; });
+      });
+    }
+  }
+
+  REQUIRE( done == 200 );
+}
+
+TEST_CASE("SharedExecutor is a ThreadPoolExecutor", "[ThreadPoolExecutor]")
+{
+  ThreadPoolExecutor* pool = dynamic_cast<ThreadPoolExecutor*>(&SharedExecutor());
+
+  REQUIRE( pool != nullptr );
+  REQUIRE( pool->WorkerCount() == ThreadPoolExecutor::DefaultWorkerCount() );
+}